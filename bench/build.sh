@@ -0,0 +1,5 @@
+#!/bin/sh
+
+cd "$(dirname "$0")/.."
+g++ -std=c++11 -O2 -Wall -o lps_bench bench/trie_bench.cxx src/trie.cxx src/frozen_trie.cxx src/stride_trie.cxx src/jump_table.cxx src/rate_store.cxx src/rate_record.cxx src/code_names.cxx src/snapshot_file.cxx src/digit_cursor.cxx src/search_result.cxx src/result_writer.cxx src/shared.cxx src/arena.cxx src/logger.cxx -I src/ -ltbb -I third_party/include/ -L third_party/lib/ -Wl,-rpath=third_party/lib
+g++ -std=c++11 -O2 -Wall -o lps_code_bench bench/code_bench.cxx src/digit_cursor.cxx -I src/
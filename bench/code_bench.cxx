@@ -0,0 +1,104 @@
+/**
+      Digit decoding cost of trie::DigitCursor against the former floating point trie::Code
+      Usage: lps_code_bench [codes_count]
+*/
+#include "digit_cursor.hxx"
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <vector>
+
+typedef std::chrono::steady_clock bench_clock_t;
+
+/**
+    trie::Code as it was before DigitCursor replaced it
+*/
+class LegacyCode {
+  private:
+    long long current_code;
+    unsigned char zero_counter;
+  public:
+    LegacyCode(unsigned long long code) : current_code(code), zero_counter(0) {}
+    bool has_more_digits() {
+      return current_code != -1;
+    }
+    char next_digit() {
+      if (current_code == -1)
+        return -1;
+      else if (current_code == 0) {
+        current_code = -1;
+        return 0;
+      }
+      else if (zero_counter > 0) {
+        zero_counter--;
+        return 0;
+      }
+      else {
+        unsigned int e = int(floor(log10(current_code)));
+        char digit;
+        if (e == 0) {
+          digit = current_code;
+          current_code = -1;
+        }
+        else {
+          long long power10 = pow(10, e);
+          digit = uint8_t(floor(current_code / power10));
+          long long base10 = digit * power10;
+          long long next_code = current_code - base10;
+          unsigned int next_e = int(floor(log10(next_code)));
+          zero_counter = e - next_e - 1;
+          current_code = next_code;
+        }
+        return digit;
+      }
+    }
+};
+
+template <typename cursor_t> unsigned long long sum_digits(const std::vector<unsigned long long> &codes, double &elapsed_ns) {
+  unsigned long long checksum = 0;
+  bench_clock_t::time_point start = bench_clock_t::now();
+  for (auto code : codes) {
+    cursor_t cursor(code);
+    while (cursor.has_more_digits())
+      checksum = checksum * 31 + cursor.next_digit();
+  }
+  elapsed_ns = std::chrono::duration<double, std::nano>(bench_clock_t::now() - start).count();
+  return checksum;
+}
+
+int main(int argc, char *argv[]) {
+  size_t codes_count = argc > 1 ? atol(argv[1]) : 5000000;
+  std::mt19937_64 rng(20170101);
+  std::vector<unsigned long long> codes;
+  for (size_t i = 0; i < codes_count; ++i) {
+    unsigned long long code = 1 + rng() % 9;
+    unsigned int length = 1 + rng() % 15;
+    for (unsigned int j = 1; j < length; ++j)
+      code = code * 10 + (rng() % 3 ? rng() % 10 : 0);      // Plenty of embedded zeros
+    codes.push_back(code);
+  }
+  double legacy_ns, cursor_ns;
+  volatile unsigned long long legacy_checksum = sum_digits<LegacyCode>(codes, legacy_ns);
+  volatile unsigned long long cursor_checksum = sum_digits<trie::DigitCursor>(codes, cursor_ns);
+  std::cout << codes_count << " codes" << std::endl << std::fixed << std::setprecision(1)
+            << std::left << std::setw(14) << "Code" << std::right << std::setw(10) << legacy_ns / codes_count << " ns/code" << std::endl
+            << std::left << std::setw(14) << "DigitCursor" << std::right << std::setw(10) << cursor_ns / codes_count << " ns/code" << std::endl;
+  if (legacy_checksum != cursor_checksum) {
+    size_t differing_count = 0;
+    for (auto code : codes) {
+      LegacyCode legacy_code(code);
+      trie::DigitCursor digit_cursor(code);
+      bool same_digits = true;
+      while (same_digits && legacy_code.has_more_digits() && digit_cursor.has_more_digits())
+        same_digits = legacy_code.next_digit() == digit_cursor.next_digit();
+      if (!same_digits || legacy_code.has_more_digits() || digit_cursor.has_more_digits())
+        differing_count++;
+    }
+    std::cout << differing_count << " codes decoded differently (Code loses the trailing zeros after the first one)" << std::endl;
+  }
+  return 0;
+}
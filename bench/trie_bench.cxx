@@ -0,0 +1,156 @@
+/**
+      Lookup latency and memory of the prefix tree engines: one digit Trie, FrozenTrie (with and
+      without jump table, one code at a time and batched) and StrideTrie
+      Usage: lps_bench [prefixes_count] [lookups_count]
+*/
+#include "trie.hxx"
+#include "frozen_trie.hxx"
+#include "stride_trie.hxx"
+#include "search_result.hxx"
+#include "code_names.hxx"
+#include "shared.hxx"
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+typedef std::chrono::steady_clock bench_clock_t;
+typedef std::function<void(unsigned long long, search::SearchResult&)> lookup_t;
+typedef std::function<void(const std::vector<unsigned long long>&, search::SearchResult&)> batch_lookup_t;
+
+const time_t REFERENCE_TIME = 1500000000;
+const unsigned int NAMES_COUNT = 200;
+const unsigned char JUMP_DIGITS = 4;
+
+/**
+    Bytes taken by the nodes of a one digit prefix tree (rate records excluded)
+*/
+size_t trie_memory_usage(trie::p_trie_t trie) {
+  size_t usage = sizeof(trie::Trie);
+  bool has_children = false;
+  for (unsigned char i = 0; i < 10; ++i)
+    if (trie->has_child(i)) {
+      usage += trie_memory_usage(trie->get_child(i));
+      has_children = true;
+    }
+  if (has_children)
+    usage += 10 * sizeof(trie::trie_child_t);
+  return usage;
+}
+
+/**
+    E.164 like prefixes: a country code of 1 to 3 digits followed by 0 to 7 more digits
+*/
+unsigned long long random_prefix(std::mt19937_64 &rng) {
+  unsigned long long prefix = 1 + rng() % 9;
+  unsigned int country_length = 1 + rng() % 3;
+  unsigned int length = country_length + rng() % 8;
+  for (unsigned int i = 1; i < length; ++i)
+    prefix = prefix * 10 + rng() % 10;
+  return prefix;
+}
+
+/**
+    Numbers to look up: a known prefix extended up to 11 to 15 digits, or a random number (likely a miss)
+*/
+unsigned long long random_number(std::mt19937_64 &rng, const std::vector<unsigned long long> &prefixes) {
+  unsigned long long number = (rng() % 4) ? prefixes[rng() % prefixes.size()] : random_prefix(rng);
+  unsigned int length = 11 + rng() % 5;
+  while (std::to_string(number).size() < length)
+    number = number * 10 + rng() % 10;
+  return number;
+}
+
+void print_lookups(const std::string &engine, bench_clock_t::time_point start, size_t lookups_count, size_t memory_usage) {
+  double elapsed_ns = std::chrono::duration<double, std::nano>(bench_clock_t::now() - start).count();
+  std::cout << std::left << std::setw(22) << engine
+            << std::right << std::setw(12) << std::fixed << std::setprecision(1) << elapsed_ns / lookups_count << " ns/lookup"
+            << std::setw(14) << memory_usage / 1024 << " KiB" << std::endl;
+}
+
+void run_lookups(const std::string &engine, const std::vector<unsigned long long> &numbers, size_t memory_usage, lookup_t lookup) {
+  search::SearchResult search_result;
+  bench_clock_t::time_point start = bench_clock_t::now();
+  for (auto number : numbers)
+    lookup(number, search_result);
+  print_lookups(engine, start, numbers.size(), memory_usage);
+}
+
+void run_batch_lookups(const std::string &engine, const std::vector<unsigned long long> &numbers, size_t memory_usage, batch_lookup_t batch_lookup) {
+  search::SearchResult search_result;
+  bench_clock_t::time_point start = bench_clock_t::now();
+  batch_lookup(numbers, search_result);
+  print_lookups(engine, start, numbers.size(), memory_usage);
+}
+
+int main(int argc, char *argv[]) {
+  size_t prefixes_count = argc > 1 ? atol(argv[1]) : 200000;
+  size_t lookups_count = argc > 2 ? atol(argv[2]) : 1000000;
+  std::mt19937_64 rng(20170101);
+
+  ctrl::Arena arena;
+  std::map<std::string, ctrl::p_code_value_t> code_names;
+  for (unsigned int i = 0; i < NAMES_COUNT; ++i)
+    code_names["CODE NAME " + std::to_string(i)] = ctrl::create_code_value(&arena, 0);
+  std::vector<ctrl::p_code_pair_t> code_items;
+  ctrl::CodeNames interned_code_names;
+  for (auto &code_name : code_names) {
+    code_items.push_back(reinterpret_cast<ctrl::p_code_pair_t>(&code_name));
+    interned_code_names.intern(code_items.back());
+  }
+
+  std::vector<unsigned long long> prefixes;
+  ctrl::Arena trie_arena;
+  trie::p_trie_t trie = trie_arena.create<trie::Trie>(1);
+  for (size_t i = 0; i < prefixes_count; ++i) {
+    unsigned long long prefix = random_prefix(rng);
+    prefixes.push_back(prefix);
+    double rate = 0.001 + (rng() % 100000) / 100000.0;
+    trie::Trie::insert_code(trie, &trie_arena, prefix, code_items[rng() % code_items.size()], 1,
+                            rate, rate, rate, rate, REFERENCE_TIME - 86400, -1, REFERENCE_TIME, 1 + rng() % 100);
+  }
+  std::vector<unsigned long long> numbers;
+  for (size_t i = 0; i < lookups_count; ++i)
+    numbers.push_back(random_number(rng, prefixes));
+  std::cout << prefixes_count << " prefixes, " << lookups_count << " lookups (rate store excluded from memory)" << std::endl;
+
+  run_lookups("Trie", numbers, trie_memory_usage(trie),
+    [&](unsigned long long number, search::SearchResult &search_result) {
+      trie::Trie::search_code(trie, number, trie::RATE_TYPE_DEFAULT, REFERENCE_TIME, search_result);
+    });
+
+  trie::FrozenTrie frozen_trie(trie);
+  trie_arena.clear();
+  run_lookups("FrozenTrie", numbers, frozen_trie.memory_usage(),
+    [&](unsigned long long number, search::SearchResult &search_result) {
+      frozen_trie.search_code(number, trie::RATE_TYPE_DEFAULT, REFERENCE_TIME, search_result);
+    });
+  run_batch_lookups("FrozenTrie batch", numbers, frozen_trie.memory_usage(),
+    [&](const std::vector<unsigned long long> &numbers, search::SearchResult &search_result) {
+      frozen_trie.search_codes(numbers.data(), numbers.size(), trie::RATE_TYPE_DEFAULT, REFERENCE_TIME, search_result);
+    });
+
+  for (unsigned char stride = 2; stride <= trie::StrideTrie::MAX_STRIDE; ++stride) {
+    trie::StrideTrie stride_trie(frozen_trie, stride);
+    run_lookups("StrideTrie(" + std::to_string(stride) + ")", numbers, stride_trie.memory_usage(),
+      [&](unsigned long long number, search::SearchResult &search_result) {
+        stride_trie.search_code(number, trie::RATE_TYPE_DEFAULT, REFERENCE_TIME, search_result);
+      });
+  }
+
+  frozen_trie.add_jump_table(JUMP_DIGITS);
+  run_lookups("FrozenTrie+jump", numbers, frozen_trie.memory_usage(),
+    [&](unsigned long long number, search::SearchResult &search_result) {
+      frozen_trie.search_code(number, trie::RATE_TYPE_DEFAULT, REFERENCE_TIME, search_result);
+    });
+  run_batch_lookups("FrozenTrie+jump batch", numbers, frozen_trie.memory_usage(),
+    [&](const std::vector<unsigned long long> &numbers, search::SearchResult &search_result) {
+      frozen_trie.search_codes(numbers.data(), numbers.size(), trie::RATE_TYPE_DEFAULT, REFERENCE_TIME, search_result);
+    });
+  return 0;
+}
@@ -0,0 +1,76 @@
+#include "arena.hxx"
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace ctrl;
+
+Arena::Arena(bool huge_pages, size_t slab_size) : huge_pages(huge_pages), slab_size(slab_size), current_slab(nullptr) {}
+
+Arena::~Arena() {
+  clear();
+}
+
+/**
+    Returns memory for an object of the given size, aligned to ALIGNMENT
+*/
+void *Arena::allocate(size_t size) {
+  size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+  while (true) {
+    p_slab_t slab = current_slab.load(std::memory_order_acquire);
+    if (slab) {
+      size_t offset = slab->used.fetch_add(size, std::memory_order_relaxed);
+      if (offset + size <= slab->size)
+        return slab->data + offset;
+    }
+    add_slab(slab, size);
+  }
+}
+
+/**
+    Maps a new current slab, big enough for the given size, unless another thread already replaced the full one
+*/
+void Arena::add_slab(p_slab_t full_slab, size_t size) {
+  std::lock_guard<std::mutex> slabs_lock(slabs_mutex);
+  if (current_slab.load(std::memory_order_acquire) != full_slab)
+    return;
+  size_t page_size = sysconf(_SC_PAGESIZE);
+  size_t header_size = (sizeof(slab_t) + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+  size_t mapped_size = header_size + size > slab_size ? header_size + size : slab_size;
+  mapped_size = (mapped_size + page_size - 1) / page_size * page_size;
+  void *mapping = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mapping == MAP_FAILED)
+    throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+  if (huge_pages)
+    madvise(mapping, mapped_size, MADV_HUGEPAGE);
+#endif
+  p_slab_t slab = static_cast<p_slab_t>(mapping);
+  slab->mapped_size = mapped_size;
+  slab->data = static_cast<char*>(mapping) + header_size;
+  slab->size = mapped_size - header_size;
+  new (&slab->used) std::atomic<size_t>(0);
+  slabs.push_back(slab);
+  current_slab.store(slab, std::memory_order_release);
+}
+
+/**
+    Bytes mapped by the slabs
+*/
+size_t Arena::memory_usage() {
+  std::lock_guard<std::mutex> slabs_lock(slabs_mutex);
+  size_t usage = 0;
+  for (auto it = slabs.begin(); it != slabs.end(); ++it)
+    usage += (*it)->mapped_size;
+  return usage;
+}
+
+/**
+    Unmaps every slab, dropping all the objects at once. Not thread-safe against allocations.
+*/
+void Arena::clear() {
+  std::lock_guard<std::mutex> slabs_lock(slabs_mutex);
+  current_slab.store(nullptr, std::memory_order_release);
+  for (auto it = slabs.begin(); it != slabs.end(); ++it)
+    munmap(*it, (*it)->mapped_size);
+  std::vector<p_slab_t>().swap(slabs);
+}
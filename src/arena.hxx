@@ -0,0 +1,86 @@
+/**
+      Bump allocator over large memory mapped slabs, released all at once
+*/
+#ifndef ARENA_HXX
+#define ARENA_HXX
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <new>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+namespace ctrl {
+
+  class Arena;
+  typedef Arena* p_arena_t;
+
+  /**
+      Objects are never freed one by one and their destructors are never run: the slabs go back
+      to the operating system when the arena is cleared or deleted. Allocation is lock-free,
+      except for mapping a new slab once the current one is full.
+  */
+  class Arena {
+    private:
+      typedef struct {
+        size_t mapped_size;
+        char *data;
+        size_t size;
+        std::atomic<size_t> used;
+      } slab_t;
+      typedef slab_t* p_slab_t;
+      bool huge_pages;
+      size_t slab_size;
+      std::atomic<p_slab_t> current_slab;
+      std::mutex slabs_mutex;
+      std::vector<p_slab_t> slabs;
+      void add_slab(p_slab_t full_slab, size_t size);
+    public:
+      static const size_t ALIGNMENT = 8;
+      static const size_t DEFAULT_SLAB_SIZE = 32 << 20;
+      Arena(bool huge_pages = false, size_t slab_size = DEFAULT_SLAB_SIZE);
+      ~Arena();
+      void *allocate(size_t size);
+      template<typename T, typename... Args>
+      T *create(Args&&... args) {
+        static_assert(alignof(T) <= ALIGNMENT, "Arena objects can't need a wider alignment than ALIGNMENT");
+        return new (allocate(sizeof(T))) T(std::forward<Args>(args)...);
+      }
+      size_t memory_usage();
+      void clear();
+  };
+
+  /**
+      Standard allocator handing out arena memory, deallocation does nothing
+  */
+  template<typename T>
+  class ArenaAllocator {
+    public:
+      typedef T value_type;
+      typedef T* pointer;
+      typedef const T* const_pointer;
+      typedef T& reference;
+      typedef const T& const_reference;
+      typedef size_t size_type;
+      typedef ptrdiff_t difference_type;
+      template<typename U> struct rebind { typedef ArenaAllocator<U> other; };
+      p_arena_t arena;
+      ArenaAllocator(p_arena_t arena) : arena(arena) {}
+      template<typename U> ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+      pointer address(reference value) const { return &value; }
+      const_pointer address(const_reference value) const { return &value; }
+      pointer allocate(size_type count, const void* = 0) { return static_cast<pointer>(arena->allocate(count * sizeof(T))); }
+      void deallocate(pointer, size_type) {}
+      size_type max_size() const { return SIZE_MAX / sizeof(T); }
+      template<typename U, typename... Args> void construct(U *p, Args&&... args) { ::new((void*)p) U(std::forward<Args>(args)...); }
+      template<typename U> void destroy(U *p) { p->~U(); }
+  };
+
+  template<typename T, typename U>
+  bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) { return a.arena == b.arena; }
+  template<typename T, typename U>
+  bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) { return a.arena != b.arena; }
+}
+#endif
@@ -0,0 +1,91 @@
+#include "code_name_results.hxx"
+#include <tbb/tbb.h>
+#include <algorithm>
+
+using namespace ctrl;
+using namespace trie;
+
+/**
+    Runs the search of every code name and rate type in parallel, taking the matches out of each
+    result. The results of a task buffer their matches in one arena, dropped with the task.
+*/
+CodeNameResults::CodeNameResults(uint32_t code_names_count, const code_name_search_t &code_name_search) {
+  size_t results_count = (size_t)code_names_count * RATE_TYPES_COUNT;
+  std::vector<std::vector<code_name_match_t>> results(results_count);
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, results_count),
+    [&](const tbb::blocked_range<size_t> &r) {
+      search::search_matches_t search_matches;
+      Arena arena(false, TASK_ARENA_SLAB_SIZE);
+      for (size_t i = r.begin(); i != r.end(); ++i) {
+        search_matches.clear();
+        search::SearchResult search_result(7, &arena);
+        code_name_search(i / RATE_TYPES_COUNT, (rate_type_t)(i % RATE_TYPES_COUNT), search_result);
+        search_result.take_matches(search_matches);
+        std::sort(search_matches.begin(), search_matches.end(), search::ranks_before);
+        std::vector<code_name_match_t> &result = results[i];
+        for (auto it = search_matches.begin(); it != search_matches.end(); ++it) {
+          if (it != search_matches.begin() && search::same_rank(*it, *(it - 1)))
+            continue;       // A search result keeps the first one ranked
+          code_name_match_t match;
+          match.rate_table_id = it->rate_table_id;
+          match.code_name_id = it->code_name_id;
+          match.egress_trunk_id = it->egress_trunk_id;
+          match.current_min_rate = RateStore::to_fixed_rate(it->current_min_rate);
+          match.current_max_rate = RateStore::to_fixed_rate(it->current_max_rate);
+          match.future_min_rate = RateStore::to_fixed_rate(it->future_min_rate);
+          match.future_max_rate = RateStore::to_fixed_rate(it->future_max_rate);
+          match.effective_date = RateStore::to_compact_date(it->effective_date);
+          match.end_date = RateStore::to_compact_date(it->end_date);
+          match.future_effective_date = RateStore::to_compact_date(it->future_effective_date);
+          match.future_end_date = RateStore::to_compact_date(it->future_end_date);
+          result.push_back(match);
+        }
+      }
+    });
+  results_end.resize(results_count);
+  size_t matches_count = 0;
+  for (size_t i = 0; i < results_count; ++i) {
+    matches_count += results[i].size();
+    results_end[i] = matches_count;
+  }
+  matches.reserve(matches_count);
+  for (size_t i = 0; i < results_count; ++i) {
+    matches.insert(matches.end(), results[i].begin(), results[i].end());
+    std::vector<code_name_match_t>().swap(results[i]);
+  }
+}
+
+size_t CodeNameResults::size() const {
+  return matches.size();
+}
+
+size_t CodeNameResults::memory_usage() const {
+  return matches.capacity() * sizeof(code_name_match_t) + results_end.capacity() * sizeof(size_t);
+}
+
+/**
+    Inserts the matches of the given code name and rate type, as the search of the code name would
+*/
+void CodeNameResults::insert_into(uint32_t code_name_id, rate_type_t rate_type, time_t reference_time, search::SearchResult &search_result) const {
+  size_t result_index = (size_t)code_name_id * RATE_TYPES_COUNT + rate_type;
+  if (result_index >= results_end.size())
+    return;
+  size_t begin = result_index ? results_end[result_index - 1] : 0;
+  for (size_t i = begin; i < results_end[result_index]; ++i) {
+    const code_name_match_t &match = matches[i];
+    search_result.insert(0,
+                         match.code_name_id,
+                         match.rate_table_id,
+                         rate_type,
+                         RateStore::from_fixed_rate(match.current_min_rate),
+                         RateStore::from_fixed_rate(match.current_max_rate),
+                         RateStore::from_fixed_rate(match.future_min_rate),
+                         RateStore::from_fixed_rate(match.future_max_rate),
+                         RateStore::from_compact_date(match.effective_date),
+                         RateStore::from_compact_date(match.end_date),
+                         RateStore::from_compact_date(match.future_effective_date),
+                         RateStore::from_compact_date(match.future_end_date),
+                         reference_time,
+                         match.egress_trunk_id);
+  }
+}
@@ -0,0 +1,54 @@
+/**
+      Results of every code name search of a generation, computed once after the load
+*/
+#ifndef CODE_NAME_RESULTS_HXX
+#define CODE_NAME_RESULTS_HXX
+
+#include "search_result.hxx"
+#include "rate_store.hxx"
+#include "shared.hxx"
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+#include <time.h>
+
+namespace ctrl {
+
+  class CodeNameResults;
+  typedef CodeNameResults* p_code_name_results_t;
+
+  /**
+      Keeps, per code name id and rate type, the matches the search of the code name inserts in its
+      result, one per rank (the ones a search result keeps), stored in
+      the RateStore encoding. The matches are inserted again for each request, since the future
+      rates shown depend on its days ahead.
+  */
+  class CodeNameResults {
+    private:
+      static const size_t TASK_ARENA_SLAB_SIZE = 1 << 20;
+      typedef struct {
+        uint32_t rate_table_id;
+        uint32_t code_name_id;
+        uint32_t egress_trunk_id;
+        trie::fixed_rate_t current_min_rate;
+        trie::fixed_rate_t current_max_rate;
+        trie::fixed_rate_t future_min_rate;
+        trie::fixed_rate_t future_max_rate;
+        trie::compact_date_t effective_date;
+        trie::compact_date_t end_date;
+        trie::compact_date_t future_effective_date;
+        trie::compact_date_t future_end_date;
+      } code_name_match_t;
+      std::vector<code_name_match_t> matches;
+      std::vector<size_t> results_end;
+    public:
+      /** Searches the given code name and rate type into the given result */
+      typedef std::function<void(uint32_t, trie::rate_type_t, search::SearchResult&)> code_name_search_t;
+      CodeNameResults(uint32_t code_names_count, const code_name_search_t &code_name_search);
+      size_t size() const;
+      size_t memory_usage() const;
+      void insert_into(uint32_t code_name_id, trie::rate_type_t rate_type, time_t reference_time, search::SearchResult &search_result) const;
+  };
+}
+#endif
@@ -0,0 +1,78 @@
+#include "code_names.hxx"
+#include <tbb/tbb.h>
+#include <algorithm>
+
+using namespace ctrl;
+
+CodeNames::CodeNames() {}
+
+/**
+    Starts from the ids of the loaded generation, whose code names a delta load keeps adding to
+*/
+void CodeNames::inherit(const CodeNames &loaded_code_names) {
+  code_items = loaded_code_names.code_items;
+}
+
+/**
+    Returns the id of the given code name, assigning the next one if it has none yet
+*/
+uint32_t CodeNames::intern(p_code_pair_t code_item) {
+  p_code_value_t code_value = code_item->second;
+  uint32_t code_name_id = code_value->code_name_id.load(std::memory_order_relaxed);
+  if (code_name_id == NO_CODE_NAME_ID) {
+    code_name_id = code_items.size();
+    code_items.push_back(code_item);
+    code_value->code_name_id.store(code_name_id, std::memory_order_release);
+  }
+  return code_name_id;
+}
+
+uint32_t CodeNames::size() const {
+  return code_items.size();
+}
+
+p_code_pair_t CodeNames::get_code_item(uint32_t code_name_id) const {
+  return code_items[code_name_id];
+}
+
+const std::string &CodeNames::get_code_name(uint32_t code_name_id) const {
+  return code_items[code_name_id]->first;
+}
+
+/**
+    Copies the code set of every code name into the sorted arrays
+*/
+void CodeNames::freeze() {
+  code_sets_end.resize(code_items.size());
+  size_t codes_count = 0;
+  for (size_t i = 0; i < code_items.size(); ++i) {
+    codes_count += code_items[i]->second->code_set->size();
+    code_sets_end[i] = codes_count;
+  }
+  std::vector<unsigned long long>(codes_count).swap(codes);
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, code_items.size()),
+    [&](const tbb::blocked_range<size_t> &r) {
+      for (size_t i = r.begin(); i != r.end(); ++i) {
+        p_code_set_t code_set = code_items[i]->second->code_set;
+        unsigned long long *code_set_begin = codes.data() + (i ? code_sets_end[i - 1] : 0);
+        std::copy(code_set->begin(), code_set->end(), code_set_begin);
+        std::sort(code_set_begin, codes.data() + code_sets_end[i]);
+      }
+    });
+}
+
+const unsigned long long *CodeNames::codes_begin(uint32_t code_name_id) const {
+  return codes.data() + (code_name_id ? code_sets_end[code_name_id - 1] : 0);
+}
+
+const unsigned long long *CodeNames::codes_end(uint32_t code_name_id) const {
+  return codes.data() + code_sets_end[code_name_id];
+}
+
+/**
+    Codes of every code name, sorted by code name id then by code: a code having several code
+    names shows up once per code name
+*/
+const std::vector<unsigned long long> &CodeNames::get_all_codes() const {
+  return codes;
+}
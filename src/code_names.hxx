@@ -0,0 +1,43 @@
+/**
+      Code names of a generation, interned as dense ids, with their code sets as sorted arrays
+*/
+#ifndef CODE_NAMES_HXX
+#define CODE_NAMES_HXX
+
+#include "shared.hxx"
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace ctrl {
+
+  class CodeNames;
+  typedef CodeNames* p_code_names_t;
+
+  /**
+      Rate stores, search filters and search results refer to code names by id: names are only
+      looked up to select the partition of a code name and to print the results.
+      Ids are assigned once a load is over, in a single thread, and a delta load keeps the ids of
+      the loaded generation. The code sets are copied from the loading (concurrent) sets by freeze,
+      the codes of each code name sorted and stored one after the other.
+  */
+  class CodeNames {
+    private:
+      std::vector<p_code_pair_t> code_items;
+      std::vector<unsigned long long> codes;
+      std::vector<size_t> code_sets_end;
+    public:
+      CodeNames();
+      void inherit(const CodeNames &loaded_code_names);
+      uint32_t intern(p_code_pair_t code_item);
+      uint32_t size() const;
+      p_code_pair_t get_code_item(uint32_t code_name_id) const;
+      const std::string &get_code_name(uint32_t code_name_id) const;
+      void freeze();
+      const unsigned long long *codes_begin(uint32_t code_name_id) const;
+      const unsigned long long *codes_end(uint32_t code_name_id) const;
+      const std::vector<unsigned long long> &get_all_codes() const;
+  };
+}
+#endif
@@ -2,113 +2,107 @@
 #include "exceptions.hxx"
 #include "rest.hxx"
 #include "telnet.hxx"
-#include "code.hxx"
+#include "digit_cursor.hxx"
+#include "snapshot.hxx"
+#include "load_pipeline.hxx"
 #include "logger.hxx"
 #include <string>
 #include <httpserver.hpp>
 #include <iostream>
 #include <thread>
+#include <chrono>
 #include <queue>
+#include <set>
+#include <map>
+#include <algorithm>
+#include <malloc.h>
 #include <tbb/tbb.h>
 #include <tbb/flow_graph.h>
 
 using namespace ctrl;
 using namespace tbb::flow;
 
-Controller::Controller(db::ConnectionInfo &conn_info,
-                       unsigned int telnet_listen_port,
-                       unsigned int http_listen_port)
+Controller::Controller(db::ConnectionInfo &conn_info, ControllerOptions &options)
   : conn_info(&conn_info),
-    world_tables_tries(nullptr),
-    us_tables_tries(nullptr),
-    az_tables_tries(nullptr),
-    codes(nullptr),
-    old_world_tables_tries(nullptr),
-    old_us_tables_tries(nullptr),
-    old_az_tables_tries(nullptr),
-    old_codes(nullptr),
-    telnet_listen_port(telnet_listen_port),
-    http_listen_port(http_listen_port),
-    updating_tables(false),
-    clearing_tables(false)
+    options(&options),
+    loaded_generation(nullptr),
+    loaded_rate_id(0),
+    delta_loads_count(0),
+    delta_load(false),
+    code_name_creation_races(0),
+    table_creation_races(0)
 {
-  reset_new_tables();
   for (size_t i = 0; i < conn_info.conn_count; ++i) {
-    tries_release_queues.push_back(new trie_release_queue_t());
-    codes_release_queues.push_back(new code_release_queue_t());
+    load_arenas.push_back(new Arena(options.huge_pages));
+    load_shards.push_back(new LoadShard(i));
   }
+  reset_new_tables();
 }
 
 Controller::~Controller() {
-  clear_tables();
-  for (size_t i = 0; i < tries_release_queues.size(); ++i) {
-    delete tries_release_queues[i];
-    codes_release_queues[i]->clear();
-    delete codes_release_queues[i];
+  delete published_generation.replace(nullptr);
+  for (size_t i = 0; i < load_arenas.size(); ++i) {
+    delete load_arenas[i];
+    delete load_shards[i];
   }
-  tries_release_queues.clear();
-  codes_release_queues.clear();
+  load_arenas.clear();
+  load_shards.clear();
 }
 
-void Controller::clear_tables() {
-  log("Clearing tables...will push tries to release queues...");
-  clearing_tables = true;
-  for (auto it = old_world_tables_tries->begin(); it != old_world_tables_tries->end(); ++it) {
-    unsigned int worker_index = (*it)->get_worker_index();
-    p_trie_release_queue_t trie_release_queue = tries_release_queues[worker_index];
-    trie_release_queue->push(*it);
-  }
-  for (auto it = old_us_tables_tries->begin(); it != old_us_tables_tries->end(); ++it) {
-    unsigned int worker_index = (*it)->get_worker_index();
-    p_trie_release_queue_t trie_release_queue = tries_release_queues[worker_index];
-    trie_release_queue->push(*it);
-  }
-  for (auto it = old_az_tables_tries->begin(); it != old_az_tables_tries->end(); ++it) {
-    unsigned int worker_index = (*it)->get_worker_index();
-    p_trie_release_queue_t trie_release_queue = tries_release_queues[worker_index];
-    trie_release_queue->push(*it);
-  }
-  log("Tries pushed... releasing vectors...");
-  old_world_tables_tries->clear();
-  old_us_tables_tries->clear();
-  old_az_tables_tries->clear();
-  delete old_world_tables_tries;
-  delete old_us_tables_tries;
-  delete old_az_tables_tries;
-  old_world_tables_index->clear();
-  old_us_tables_index->clear();
-  old_az_tables_index->clear();
-  delete old_world_tables_index;
-  delete old_us_tables_index;
-  delete old_az_tables_index;
-  log("Vectors released.... realeasing codes...");
-  for (auto it = old_codes->begin(); it != old_codes->end(); ++it) {
-    p_code_value_t code_value = it->second;
-    unsigned int worker_index = code_value->first;
-    p_code_release_queue_t code_release_queue = codes_release_queues[worker_index];
-    code_release_queue->push(code_value);
+/**
+    One arena per worker, so loaders seldom allocate from the same slab
+*/
+p_arenas_t Controller::create_arenas() {
+  p_arenas_t arenas = new arenas_t();
+  for (size_t i = 0; i < conn_info->conn_count; ++i)
+    arenas->push_back(new Arena(options->huge_pages));
+  return arenas;
+}
+
+/**
+    Hands the frozen tables over to readers as a new generation, then releases the previous
+    generation once the last reader pinning it is done
+*/
+void Controller::publish_new_tables() {
+  p_generation_t generation = new Generation(reference_time);
+  generation->world_tables_tries = new_world_frozen_tables;
+  generation->world_tables_index = new_world_tables_index;
+  generation->world_unified_index = new_world_unified_index;
+  generation->us_tables_tries = new_us_frozen_tables;
+  generation->us_tables_index = new_us_tables_index;
+  generation->us_unified_index = new_us_unified_index;
+  generation->az_tables_tries = new_az_frozen_tables;
+  generation->az_tables_index = new_az_tables_index;
+  generation->az_unified_index = new_az_unified_index;
+  generation->codes = new_codes;
+  generation->code_names = new_code_names;
+  generation->codes_arenas = new_codes_arenas;
+  if (delta_load)
+    loaded_generation->codes_handed_over = true;
+  if (options->code_name_results)
+    compute_code_name_results(generation);
+  p_generation_t old_generation = published_generation.replace(generation);
+  loaded_generation = generation;
+  if (old_generation) {
+    log("Clearing tables... releasing previous generation...");
+    delete old_generation;
+    malloc_trim(0);
+    log("Tables cleared.");
   }
-  old_codes->clear();
-  delete old_codes;
-  clearing_tables = false;
-  log("Tables cleared.");
-}
-
-void Controller::renew_tables() {
-  old_world_tables_index = world_tables_index;
-  old_world_tables_tries = world_tables_tries;
-  old_us_tables_index = us_tables_index;
-  old_us_tables_tries = us_tables_tries;
-  old_az_tables_index = az_tables_index;
-  old_az_tables_tries = az_tables_tries;
-  old_codes = codes;
-  world_tables_index = new_world_tables_index;
-  world_tables_tries = new_world_tables_tries;
-  us_tables_index = new_us_tables_index;
-  us_tables_tries = new_us_tables_tries;
-  az_tables_index = new_az_tables_index;
-  az_tables_tries = new_az_tables_tries;
-  codes = new_codes;
+}
+
+/**
+    Searches every code name of the given generation, before it is published, so code name
+    searches only have to copy their results
+*/
+void Controller::compute_code_name_results(p_generation_t generation) {
+  log("Computing the results of " + std::to_string(generation->code_names->size()) + " code names...");
+  generation->code_name_results = new CodeNameResults(generation->code_names->size(),
+    [&](uint32_t code_name_id, trie::rate_type_t rate_type, search::SearchResult &result) {
+      _search_code_name(generation, code_name_id, rate_type, result);
+    });
+  log("Code name results: " + std::to_string(generation->code_name_results->size()) + " matches, " +
+      std::to_string(generation->code_name_results->memory_usage() >> 20) + " MiB.");
 }
 
 void Controller::reset_new_tables() {
@@ -118,22 +112,338 @@ void Controller::reset_new_tables() {
   new_us_tables_tries = new tables_tries_t();
   new_az_tables_index = new tables_index_t();
   new_az_tables_tries = new tables_tries_t();
-  new_codes = new codes_t();
+  new_world_frozen_tables = nullptr;
+  new_us_frozen_tables = nullptr;
+  new_az_frozen_tables = nullptr;
+  new_world_unified_index = nullptr;
+  new_us_unified_index = nullptr;
+  new_az_unified_index = nullptr;
+}
+
+/**
+    Drops the loading tries all at once, by clearing the loading arenas
+*/
+void Controller::release_load_tables() {
+  size_t arenas_usage = 0;
+  for (size_t i = 0; i < load_arenas.size(); ++i)
+    arenas_usage += load_arenas[i]->memory_usage();
+  for (p_tables_tries_t tables_tries : {new_world_tables_tries, new_us_tables_tries, new_az_tables_tries}) {
+    tables_tries->clear();
+    delete tables_tries;
+  }
+  new_world_tables_tries = nullptr;
+  new_us_tables_tries = nullptr;
+  new_az_tables_tries = nullptr;
+  for (size_t i = 0; i < load_arenas.size(); ++i)
+    load_arenas[i]->clear();
+  log("Loading tries released: " + std::to_string(arenas_usage >> 20) + " MiB returned to the system.");
+}
+
+/**
+    Freezes the tries referenced by the tables index, in creation order, and points the index at
+    their position in the frozen vector (tries left over by table creation races are skipped)
+*/
+p_frozen_tables_t Controller::freeze_tables(p_tables_tries_t tables_tries, p_tables_index_t tables_index) {
+  std::vector<std::pair<size_t, unsigned int>> tables_positions;
+  for (auto it = tables_index->begin(); it != tables_index->end(); ++it)
+    tables_positions.push_back(std::make_pair(it->second, it->first));
+  std::sort(tables_positions.begin(), tables_positions.end());
+  p_frozen_tables_t frozen_tables = new frozen_tables_t(tables_positions.size());
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, tables_positions.size()),
+    [&](const tbb::blocked_range<size_t> &r) {
+      for (size_t i = r.begin(); i != r.end(); ++i) {
+        (*frozen_tables)[i] = new trie::FrozenTrie((*tables_tries)[tables_positions[i].first]);
+        (*frozen_tables)[i]->add_jump_table(options->jump_digits);
+      }
+    });
+  for (size_t i = 0; i < tables_positions.size(); ++i)
+    (*tables_index)[tables_positions[i].second] = i;
+  return frozen_tables;
+}
+
+trie::p_unified_index_t Controller::unify_tables(p_frozen_tables_t frozen_tables) {
+  trie::p_unified_index_t unified_index = new trie::UnifiedIndex(frozen_tables);
+  unified_index->add_jump_table(options->jump_digits);
+  log("Unified index of " + std::to_string(frozen_tables->size()) + " rate tables: " + std::to_string(unified_index->size()) +
+      " nodes, " + std::to_string(unified_index->postings_size()) + " postings.");
+  return unified_index;
+}
+
+void Controller::restride_tables(p_frozen_tables_t frozen_tables) {
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, frozen_tables->size()),
+    [&](const tbb::blocked_range<size_t> &r) {
+      for (size_t i = r.begin(); i != r.end(); ++i)
+        (*frozen_tables)[i]->restride(options->trie_stride);
+    });
+}
+
+/**
+    Completes the tables of a delta load with the loaded tables that got no new rows. The loaded
+    generation hands them over instead of releasing them.
+*/
+void Controller::inherit_tables(p_frozen_tables_t frozen_tables, p_tables_index_t tables_index, p_frozen_tables_t loaded_tables, p_tables_index_t loaded_index) {
+  for (auto it = loaded_index->begin(); it != loaded_index->end(); ++it) {
+    if (tables_index->find(it->first) != tables_index->end())
+      continue;
+    trie::p_frozen_trie_t frozen_trie = (*loaded_tables)[it->second];
+    size_t index = frozen_tables->push_back(frozen_trie) - frozen_tables->begin();
+    tables_index->insert(std::make_pair(it->first, index));
+    loaded_generation->handed_over_tables.insert(frozen_trie);
+  }
+}
+
+/**
+    Logs how many lock-free insertions lost a race against another loader during the load
+*/
+void Controller::log_insertion_races() {
+  trie::insertion_races_t insertion_races = trie::Trie::take_insertion_races();
+  log("Insertion races during load: " + std::to_string(code_name_creation_races.exchange(0)) + " code names, " +
+      std::to_string(table_creation_races.exchange(0)) + " rate tables, " +
+      std::to_string(insertion_races.child_creation_races) + " trie nodes, " +
+      std::to_string(insertion_races.record_publication_races) + " rate records.");
+}
+
+/**
+    Reports the rates loaded above what the rate store holds, which rank and show as MAX_FIXED_RATE
+*/
+void Controller::log_clamped_rates() {
+  unsigned long long clamped_rates = trie::RateStore::take_clamped_rates();
+  if (clamped_rates)
+    error("Rates above " + std::to_string(trie::MAX_FIXED_RATE) + " during load: " + std::to_string(clamped_rates) +
+          " clamped, they rank and show as " + std::to_string(trie::MAX_FIXED_RATE) + ".");
+}
+
+/**
+    Builds the loading tables out of the rows of every load shard. Code names are merged first,
+    then each rate table is built by a single task, replaying the rows of the shards in worker order.
+    On delta loads, the loaded version of the table is thawed before the rows are replayed.
+*/
+void Controller::merge_load_shards() {
+  size_t rows_count = 0;
+  for (size_t i = 0; i < load_shards.size(); ++i)
+    rows_count += load_shards[i]->size();
+  log("Merging " + std::to_string(rows_count) + " rate rows from " + std::to_string(load_shards.size()) + " load shards...");
+  std::vector<shard_runs_t> shards_runs(load_shards.size());
+  std::vector<std::vector<p_code_pair_t>> shards_code_items(load_shards.size());
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, load_shards.size()),
+    [&](const tbb::blocked_range<size_t> &r) {
+      for (size_t i = r.begin(); i != r.end(); ++i) {
+        p_load_shard_t load_shard = load_shards[i];
+        shards_runs[i] = load_shard->sort_runs();
+        const std::vector<std::string> &code_names = load_shard->get_code_names();
+        for (auto it = code_names.begin(); it != code_names.end(); ++it)
+          shards_code_items[i].push_back(find_or_insert_code_name(*it, load_shard->get_worker_index()));
+      }
+    });
+  typedef std::vector<std::pair<size_t, size_t>> shard_run_refs_t;
+  std::map<std::pair<unsigned char, unsigned int>, shard_run_refs_t> tables_runs;
+  for (size_t i = 0; i < shards_runs.size(); ++i)
+    for (size_t j = 0; j < shards_runs[i].size(); ++j)
+      tables_runs[std::make_pair(shards_runs[i][j].partition, shards_runs[i][j].rate_table_id)].push_back(std::make_pair(i, j));
+  p_tables_tries_t partition_tries[3] = { new_world_tables_tries, new_us_tables_tries, new_az_tables_tries };
+  p_tables_index_t partition_index[3] = { new_world_tables_index, new_us_tables_index, new_az_tables_index };
+  typedef struct {
+    trie::p_trie_t trie;
+    p_arena_t arena;
+    trie::p_frozen_trie_t loaded_table;
+    const shard_run_refs_t *run_refs;
+  } table_merge_t;
+  std::vector<table_merge_t> tables_merges;
+  size_t thawed_count = 0;
+  for (auto it = tables_runs.begin(); it != tables_runs.end(); ++it) {
+    unsigned char partition = it->first.first;
+    unsigned int rate_table_id = it->first.second;
+    table_merge_t table_merge;
+    table_merge.arena = load_arenas[load_shards[it->second.front().first]->get_worker_index()];
+    table_merge.trie = table_merge.arena->create<trie::Trie>(rate_table_id);
+    table_merge.loaded_table = delta_load ? loaded_generation->find_table(partition, rate_table_id) : nullptr;
+    table_merge.run_refs = &it->second;
+    size_t index = partition_tries[partition]->push_back(table_merge.trie) - partition_tries[partition]->begin();
+    partition_index[partition]->insert(std::make_pair(rate_table_id, index));
+    tables_merges.push_back(table_merge);
+    if (table_merge.loaded_table)
+      thawed_count++;
+  }
+  if (delta_load)
+    log("Thawing " + std::to_string(thawed_count) + " loaded rate tables to apply the new rows...");
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, tables_merges.size()),
+    [&](const tbb::blocked_range<size_t> &r) {
+      for (size_t i = r.begin(); i != r.end(); ++i) {
+        trie::p_trie_t trie = tables_merges[i].trie;
+        if (tables_merges[i].loaded_table)
+          trie::Trie::thaw(trie, tables_merges[i].arena, *tables_merges[i].loaded_table, *new_code_names);
+        const shard_run_refs_t &run_refs = *tables_merges[i].run_refs;
+        for (auto it = run_refs.begin(); it != run_refs.end(); ++it) {
+          p_load_shard_t load_shard = load_shards[it->first];
+          const shard_run_t &run = shards_runs[it->first][it->second];
+          const std::vector<p_code_pair_t> &code_items = shards_code_items[it->first];
+          for (size_t row_index = run.begin; row_index != run.end; ++row_index) {
+            const shard_row_t &row = load_shard->get_row(row_index);
+            p_code_pair_t code_item = code_items[row.code_name_index];
+            code_item->second->code_set->insert(row.code);
+            trie::Trie::insert_code(trie, load_arenas[load_shard->get_worker_index()], row.code, code_item, run.rate_table_id,
+                                    row.rates[trie::RATE_TYPE_DEFAULT], row.rates[trie::RATE_TYPE_INTER],
+                                    row.rates[trie::RATE_TYPE_INTRA], row.rates[trie::RATE_TYPE_LOCAL],
+                                    row.effective_date, row.end_date, reference_time, row.egress_trunk_id);
+          }
+        }
+      }
+    });
+  for (size_t i = 0; i < load_shards.size(); ++i)
+    load_shards[i]->clear();
+  log("Load shards merged into " + std::to_string(tables_merges.size()) + " rate tables.");
+}
+
+/**
+    Gives an id to the code names created by the load, then copies every code set into the
+    sorted arrays of the new code names. Must run before freezing the tables, whose rate stores
+    keep the code name ids.
+*/
+void Controller::intern_new_code_names() {
+  uint32_t loaded_count = new_code_names->size();
+  for (auto it = new_codes->begin(); it != new_codes->end(); ++it)
+    new_code_names->intern(&(*it));
+  new_code_names->freeze();
+  log("Code names: " + std::to_string(new_code_names->size()) + " (" + std::to_string(new_code_names->size() - loaded_count) + " new), " +
+      std::to_string(new_code_names->get_all_codes().size()) + " codes.");
+}
+
+/**
+    Compacts the loaded tries into their read-only form and releases the loading tries
+*/
+void Controller::freeze_new_tables() {
+  log("Freezing loaded rate tables...");
+  log_insertion_races();
+  log_clamped_rates();
+  intern_new_code_names();
+  new_world_frozen_tables = freeze_tables(new_world_tables_tries, new_world_tables_index);
+  new_us_frozen_tables = freeze_tables(new_us_tables_tries, new_us_tables_index);
+  new_az_frozen_tables = freeze_tables(new_az_tables_tries, new_az_tables_index);
+  if (delta_load) {
+    inherit_tables(new_world_frozen_tables, new_world_tables_index, loaded_generation->world_tables_tries, loaded_generation->world_tables_index);
+    inherit_tables(new_us_frozen_tables, new_us_tables_index, loaded_generation->us_tables_tries, loaded_generation->us_tables_index);
+    inherit_tables(new_az_frozen_tables, new_az_tables_index, loaded_generation->az_tables_tries, loaded_generation->az_tables_index);
+  }
+  if (!options->snapshot_path.empty() && options->trie_stride > 1)
+    save_snapshot(new_code_names, new_world_frozen_tables, new_us_frozen_tables, new_az_frozen_tables);
+  if (options->unified_index) {
+    log("Building unified indices...");
+    tbb::task_group tasks;
+    tasks.run([&]{ new_world_unified_index = unify_tables(new_world_frozen_tables); });
+    tasks.run([&]{ new_us_unified_index = unify_tables(new_us_frozen_tables); });
+    tasks.run([&]{ new_az_unified_index = unify_tables(new_az_frozen_tables); });
+    tasks.wait();
+  }
+  if (options->trie_stride > 1) {
+    log("Expanding rate tables to " + std::to_string(options->trie_stride) + " digits per level...");
+    restride_tables(new_world_frozen_tables);
+    restride_tables(new_us_frozen_tables);
+    restride_tables(new_az_frozen_tables);
+  }
+  log("Rate tables frozen... releasing loading tries...");
+  release_load_tables();
+}
+
+/**
+    Writes the given frozen tables to the snapshot file. They must still have one digit per level:
+    with one digit per level they are the published ones, written once readers have them, else
+    they are written before being expanded, which delays their publication by the time logged.
+    A failure is only logged: the tables are published anyway.
+*/
+void Controller::save_snapshot(p_code_names_t code_names, p_frozen_tables_t world_tables, p_frozen_tables_t us_tables, p_frozen_tables_t az_tables) {
+  log("Saving snapshot to " + options->snapshot_path + "...");
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  try {
+    Snapshot::save(options->snapshot_path, reference_time, database->get_last_rate_id(), code_names, world_tables, us_tables, az_tables);
+    log("Snapshot saved in " + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count()) + " ms.");
+  }
+  catch (std::exception &e) {
+    error("Snapshot not saved: " + std::string(e.what()));
+  }
+}
+
+/**
+    Publishes the tables of the snapshot file, if there is a valid one, so queries are answered
+    while the first database load runs. The load after it is a delta load from the last rate_id
+    of the snapshot when delta loads are enabled, a full load otherwise.
+*/
+void Controller::load_snapshot() {
+  if (options->snapshot_path.empty())
+    return;
+  log("Loading snapshot " + options->snapshot_path + "...");
+  p_generation_t generation;
+  unsigned int snapshot_rate_id = 0;
+  try {
+    generation = Snapshot::load(options->snapshot_path, create_arenas(), snapshot_rate_id);
+  }
+  catch (std::exception &e) {
+    error("Snapshot not loaded: " + std::string(e.what()));
+    return;
+  }
+  for (p_frozen_tables_t frozen_tables : {generation->world_tables_tries, generation->us_tables_tries, generation->az_tables_tries})
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, frozen_tables->size()),
+      [&](const tbb::blocked_range<size_t> &r) {
+        for (size_t i = r.begin(); i != r.end(); ++i)
+          (*frozen_tables)[i]->add_jump_table(options->jump_digits);
+      });
+  if (options->unified_index) {
+    tbb::task_group tasks;
+    tasks.run([&]{ generation->world_unified_index = unify_tables(generation->world_tables_tries); });
+    tasks.run([&]{ generation->us_unified_index = unify_tables(generation->us_tables_tries); });
+    tasks.run([&]{ generation->az_unified_index = unify_tables(generation->az_tables_tries); });
+    tasks.wait();
+  }
+  if (options->trie_stride > 1) {
+    restride_tables(generation->world_tables_tries);
+    restride_tables(generation->us_tables_tries);
+    restride_tables(generation->az_tables_tries);
+  }
+  if (options->code_name_results)
+    compute_code_name_results(generation);
+  published_generation.replace(generation);
+  loaded_generation = generation;
+  loaded_rate_id = snapshot_rate_id;
+  log("Serving " + std::to_string(generation->world_tables_tries->size() + generation->us_tables_tries->size() + generation->az_tables_tries->size()) +
+      " rate tables from the snapshot, loaded up to rate_id " + std::to_string(snapshot_rate_id) + ".");
+}
+
+/**
+    Reads the load cycle through a LoadPipeline instead of the workers. Rows are spread over one
+    insertion partition per core, or per connection when they go to the load shards.
+*/
+void Controller::run_load_pipeline() {
+  unsigned int partitions_count = conn_info->conn_count;
+  if (!(options->sharded_load || delta_load) && (unsigned int)tbb::task_scheduler_init::default_num_threads() > partitions_count)
+    partitions_count = tbb::task_scheduler_init::default_num_threads();
+  LoadPipeline load_pipeline(database, conn_info->conn_count, partitions_count);
+  unsigned long long rows_count = load_pipeline.run();
+  log("Load pipeline done: " + std::to_string(rows_count) + " rate rows inserted.");
 }
 
 void Controller::update_rate_tables_tries() {
-  {
-    database->wait_for_reading();
-    log("Updating rate tables...");
-    std::lock_guard<std::mutex> update_lock(update_tables_mutex);
-    updating_tables = true;
-    if (old_world_tables_tries || old_us_tables_tries || old_az_tables_tries || old_codes)
-      clear_tables();
-    renew_tables();
-    reset_new_tables();
-    updating_tables = false;
+  if (options->pipelined_load)
+    run_load_pipeline();
+  database->wait_for_reading();
+  if (delta_load) {
+    size_t rows_count = 0;
+    for (size_t i = 0; i < load_shards.size(); ++i)
+      rows_count += load_shards[i]->size();
+    if (rows_count == 0) {
+      log("No new rate rows, rate tables are up to date.");
+      delete new_code_names;
+      loaded_rate_id = database->get_last_rate_id();
+      return;
+    }
   }
-  update_tables_holder.notify_all();
+  if (options->sharded_load || delta_load)
+    merge_load_shards();
+  freeze_new_tables();
+  log("Updating rate tables...");
+  publish_new_tables();
+  if (!options->snapshot_path.empty() && options->trie_stride == 1)
+    save_snapshot(loaded_generation->code_names, loaded_generation->world_tables_tries, loaded_generation->us_tables_tries, loaded_generation->az_tables_tries);
+  loaded_rate_id = database->get_last_rate_id();
+  reset_new_tables();
 }
 
 void Controller::start_workflow() {
@@ -141,45 +451,19 @@ void Controller::start_workflow() {
   tasks.run([&]{ run_logger(); });
   tasks.run([&]{ run_http_server(); });
   tasks.run([&]{ run_telnet_server(); });
-  for (size_t worker_index = 0; worker_index < conn_info->conn_count; ++worker_index)
-    tasks.run([&, worker_index]{ run_worker(worker_index); });
+  if (!options->pipelined_load)
+    for (size_t worker_index = 0; worker_index < conn_info->conn_count; ++worker_index)
+      tasks.run([&, worker_index]{ run_worker(worker_index); });
   create_table_tries();
   update_table_tries();
   tasks.wait();
 };
 
 void Controller::run_worker(unsigned int worker_index) {
-  p_trie_release_queue_t worker_trie_release_queue = tries_release_queues[worker_index];
-  p_code_release_queue_t worker_code_release_queue = codes_release_queues[worker_index];
   while (true) {
-    while (!(clearing_tables || (database != nullptr && database->is_reading())))
+    while (!(database != nullptr && database->is_reading()))
       std::this_thread::sleep_for(std::chrono::seconds(1));
-    if (database->is_reading())
-      database->read_chunk(worker_index);
-    else {
-      while (clearing_tables || !(worker_trie_release_queue->empty() && worker_code_release_queue->empty())) {
-        trie::p_trie_t some_trie;
-        p_code_value_t some_code_value;
-        while (worker_trie_release_queue->try_pop(some_trie)) {
-          if (some_trie->get_worker_index() != worker_index)
-            throw WorkerReleaseLeakException();
-          for (size_t i = 0; i < 10; ++i)
-            if (some_trie->has_child(i)) {
-              trie::p_trie_t some_child = some_trie->get_child(i);
-              unsigned int child_creator_worker = some_child->get_worker_index();
-              p_trie_release_queue_t designated_worker_queue = tries_release_queues[child_creator_worker];
-              designated_worker_queue->push(some_child);
-            }
-          delete some_trie;
-        }
-        while (worker_code_release_queue->try_pop(some_code_value)) {
-          if (some_code_value->first != worker_index)
-            throw WorkerReleaseLeakException();
-          some_code_value->second->clear();
-          delete some_code_value;
-        }
-      }
-    } // else
+    database->read_chunk(worker_index);
   }
 }
 
@@ -200,31 +484,56 @@ void Controller::run_logger() {
 
 void Controller::run_http_server() {
   rest::Rest rest_server;
-  rest_server.run_server(http_listen_port);
+  rest_server.run_server(options->http_listen_port);
 }
 
 void Controller::run_telnet_server() {
   telnet::Telnet telnet_server;
-  telnet_server.run_server(telnet_listen_port);
+  telnet_server.run_server(options->telnet_listen_port);
+}
+
+/**
+    Starts reading the database: a full load reads every rate row into new tables and code names,
+    a delta load (all but one every full_reload_every cycles) only reads the rows added since the
+    last load, applied on top of copies of the tables they touch. Rows changed in place, and
+    future rates becoming current, are only picked up by full loads.
+*/
+void Controller::start_load_cicle() {
+  reference_time = time(nullptr);
+  delta_load = loaded_generation != nullptr && options->full_reload_every > 1 && ++delta_loads_count < options->full_reload_every;
+  if (delta_load) {
+    log("Delta load of the rate rows after rate_id " + std::to_string(loaded_rate_id) + "...");
+    new_codes = loaded_generation->codes;
+    new_code_names = new CodeNames();
+    new_code_names->inherit(*loaded_generation->code_names);
+    new_codes_arenas = loaded_generation->codes_arenas;
+  }
+  else {
+    delta_loads_count = 0;
+    new_codes = new codes_t();
+    new_code_names = new CodeNames();
+    new_codes_arenas = create_arenas();
+  }
+  database->init_load_cicle(reference_time, delta_load ? loaded_rate_id : 0);
 }
 
 void Controller::create_table_tries() {
+  load_snapshot();
   database = new db::DB(*conn_info);
-  reference_time = time(nullptr);
-  database->init_load_cicle(reference_time);
+  start_load_cicle();
   update_rate_tables_tries();
 }
 
 void Controller::update_table_tries() {
   while (true) {
     database->wait_till_next_load_cicle();
-    reference_time = time(nullptr);
-    database->init_load_cicle(reference_time);
+    start_load_cicle();
     update_rate_tables_tries();
   }
 }
 
 void Controller::insert_code_name_rate_table_db() {
+  GenerationPin generation_pin(published_generation);   // Same generation, so the same code name ids, for every search
   search::SearchResult result;
   log("Searching all codes...");
   for (unsigned char i = trie::rate_type_t::RATE_TYPE_DEFAULT; i <= trie::rate_type_t::RATE_TYPE_LOCAL; ++i)
@@ -235,9 +544,9 @@ void Controller::insert_code_name_rate_table_db() {
 
 static p_controller_t controller;
 
-p_controller_t Controller::get_controller(db::ConnectionInfo &conn_info, unsigned int telnet_listen_port, unsigned int http_listen_port) {
+p_controller_t Controller::get_controller(db::ConnectionInfo &conn_info, ControllerOptions &options) {
   if (!controller) {
-    controller = new Controller(conn_info, telnet_listen_port, http_listen_port);
+    controller = new Controller(conn_info, options);
   }
   return controller;
 }
@@ -248,208 +557,346 @@ p_controller_t Controller::get_controller() {
   return controller;
 }
 
-Controller::table_trie_set_t Controller::select_table_trie(unsigned long long code, const std::string &code_name, bool inserting) {
+/**
+    Selects the tables of the partition of the code: the tables being loaded when no generation is given
+*/
+Controller::table_trie_set_t Controller::select_table_trie(unsigned long long code, const std::string &code_name, p_generation_t generation) {
   table_trie_set_t result;
-  trie::Code dyn_code(code);
-  char first_digit = dyn_code.next_digit();
+  trie::DigitCursor digit_cursor(code);
+  char first_digit = digit_cursor.next_digit();
   if (first_digit != 1) {
-    if (inserting) {
+    if (!generation) {
       result.tables_tries = new_world_tables_tries;
+      result.frozen_tables = nullptr;
+      result.unified_index = nullptr;
       result.tables_index = new_world_tables_index;
-      result.table_index_insertion_mutex = &world_table_index_insertion_mutex;
     }
     else {
-      result.tables_tries = world_tables_tries;
-      result.tables_index = world_tables_index;
-      result.table_index_insertion_mutex = nullptr;
+      result.tables_tries = nullptr;
+      result.frozen_tables = generation->world_tables_tries;
+      result.unified_index = generation->world_unified_index;
+      result.tables_index = generation->world_tables_index;
     }
   }
   else if (code_name == "USA" || code_name == "UNITED STATES") {
-    if (inserting) {
+    if (!generation) {
       result.tables_tries = new_us_tables_tries;
+      result.frozen_tables = nullptr;
+      result.unified_index = nullptr;
       result.tables_index = new_us_tables_index;
-      result.table_index_insertion_mutex = &us_table_index_insertion_mutex;
     }
     else {
-      result.tables_tries = us_tables_tries;
-      result.tables_index = us_tables_index;
-      result.table_index_insertion_mutex = nullptr;
+      result.tables_tries = nullptr;
+      result.frozen_tables = generation->us_tables_tries;
+      result.unified_index = generation->us_unified_index;
+      result.tables_index = generation->us_tables_index;
     }
   }
   else {
-    if (inserting) {
+    if (!generation) {
       result.tables_tries = new_az_tables_tries;
+      result.frozen_tables = nullptr;
+      result.unified_index = nullptr;
       result.tables_index = new_az_tables_index;
-      result.table_index_insertion_mutex = &az_table_index_insertion_mutex;
     }
     else {
-      result.tables_tries = az_tables_tries;
-      result.tables_index = az_tables_index;
-      result.table_index_insertion_mutex = nullptr;
+      result.tables_tries = nullptr;
+      result.frozen_tables = generation->az_tables_tries;
+      result.unified_index = generation->az_unified_index;
+      result.tables_index = generation->az_tables_index;
     }
   }
   return result;
 }
 
-void Controller::insert_new_rate_data(db::db_data_t db_data) {
-  codes_t::iterator it = new_codes->end();
-  str_to_upper(db_data.code_name);
-  {
-    tbb::mutex::scoped_lock lock(code_name_creation_mutex);
-    if ((it = new_codes->find(db_data.code_name)) == new_codes->end())
-      (*new_codes)[db_data.code_name] = new code_value_t(db_data.conn_index, new code_set_t());
-    (*new_codes)[db_data.code_name]->second->insert(db_data.code);
-  }
-  if (it == new_codes->end())
-    it = new_codes->find(db_data.code_name);
-  p_code_pair_t code_items =  &(*it);
-  table_trie_set_t selected_tables = select_table_trie(db_data.code, db_data.code_name, true);
-  {
-    tbb::mutex::scoped_lock lock(*selected_tables.table_index_insertion_mutex);
-    if (selected_tables.tables_index->find(db_data.rate_table_id) == selected_tables.tables_index->end()) {
-      selected_tables.tables_tries->push_back(new trie::Trie(db_data.conn_index));
-      (*selected_tables.tables_index)[db_data.rate_table_id] = selected_tables.tables_tries->size()-1;
-    }
-  }
-  size_t index = (*selected_tables.tables_index)[db_data.rate_table_id];
-  trie::p_trie_t trie = (*selected_tables.tables_tries)[index];
-  {
-    tbb::mutex::scoped_lock lock(*trie->get_mutex());
-    trie->insert_code(trie, db_data.conn_index, db_data.code, code_items, db_data.rate_table_id, db_data.default_rate, db_data.inter_rate, db_data.intra_rate, db_data.local_rate, db_data.effective_date, db_data.end_date, reference_time, db_data.egress_trunk_id);
+/**
+    Returns the loading trie of the given rate table, creating it if needed. When another loader
+    creates it first, ours stays unreferenced in the tries vector and is dropped when freezing.
+*/
+trie::p_trie_t Controller::find_or_insert_table_trie(table_trie_set_t &selected_tables, unsigned int rate_table_id, unsigned int worker_index) {
+  tables_index_t::iterator it = selected_tables.tables_index->find(rate_table_id);
+  if (it != selected_tables.tables_index->end())
+    return (*selected_tables.tables_tries)[it->second];
+  trie::p_trie_t new_trie = load_arenas[worker_index]->create<trie::Trie>(rate_table_id);
+  size_t index = selected_tables.tables_tries->push_back(new_trie) - selected_tables.tables_tries->begin();
+  std::pair<tables_index_t::iterator, bool> inserted = selected_tables.tables_index->insert(std::make_pair(rate_table_id, index));
+  if (inserted.second)
+    return new_trie;
+  table_creation_races++;
+  return (*selected_tables.tables_tries)[inserted.first->second];
+}
+
+/**
+    Returns the loading entry of the given code name, creating it if needed
+*/
+p_code_pair_t Controller::find_or_insert_code_name(const std::string &code_name, unsigned int worker_index) {
+  codes_t::iterator it = new_codes->find(code_name);
+  if (it == new_codes->end()) {
+    p_code_value_t code_value = create_code_value((*new_codes_arenas)[worker_index], worker_index);
+    std::pair<codes_t::iterator, bool> inserted = new_codes->insert(std::make_pair(code_name, code_value));
+    it = inserted.first;
+    if (!inserted.second)
+      code_name_creation_races++;
   }
+  return &(*it);
 }
 
-bool Controller::are_tables_available() {
-  return world_tables_index != nullptr && world_tables_tries != nullptr &&
-         us_tables_index != nullptr && us_tables_tries != nullptr &&
-         az_tables_index != nullptr && az_tables_tries != nullptr &&
-         codes != nullptr;
+/**
+    Inserts a rate row, lock-free: code names and rate tables are created with concurrent
+    map insertions, and prefix tree nodes and records with compare-and-swap.
+    With sharded loads (and delta loads) the row only goes to the private shard of its connection.
+*/
+void Controller::insert_new_rate_data(db::db_data_t db_data) {
+  str_to_upper(db_data.code_name);
+  table_trie_set_t selected_tables = select_table_trie(db_data.code, db_data.code_name, nullptr);
+  if (options->sharded_load || delta_load) {
+    unsigned char partition = 2;
+    if (selected_tables.tables_index == new_world_tables_index)
+      partition = 0;
+    else if (selected_tables.tables_index == new_us_tables_index)
+      partition = 1;
+    load_shards[db_data.conn_index]->add_row(db_data, partition);
+    return;
+  }
+  p_code_pair_t code_items = find_or_insert_code_name(db_data.code_name, db_data.conn_index);
+  code_items->second->code_set->insert(db_data.code);
+  trie::p_trie_t trie = find_or_insert_table_trie(selected_tables, db_data.rate_table_id, db_data.conn_index);
+  trie->insert_code(trie, load_arenas[db_data.conn_index], db_data.code, code_items, db_data.rate_table_id, db_data.default_rate, db_data.inter_rate, db_data.intra_rate, db_data.local_rate, db_data.effective_date, db_data.end_date, reference_time, db_data.egress_trunk_id);
 }
 
 void Controller::search_code(unsigned long long code, trie::rate_type_t rate_type, search::SearchResult &result) {
-  mutex_unique_lock_t update_tables_lock(update_tables_mutex);
-  update_tables_holder.wait(update_tables_lock, [&] { return updating_tables == false; });
-  update_tables_lock.unlock();
-  if (!are_tables_available())
+  GenerationPin generation_pin(published_generation);
+  p_generation_t generation = generation_pin.get();
+  if (!generation || !result.pin_generation(generation->id))
     return;
   table_trie_set_t selected_tables;
   if (code < 1000)
-    selected_tables = select_table_trie(code, "USA", false); // Code name is only used if code first digit is 1.
+    selected_tables = select_table_trie(code, "USA", generation); // Code name is only used if code first digit is 1.
   else
-    selected_tables = select_table_trie(code, "", false);    // Code name is ignored.
-  code_set_t code_set;
-  code_set.insert(code);
-  _search_code(code_set, rate_type, selected_tables, result);
-  code_set.clear();
+    selected_tables = select_table_trie(code, "", generation);    // Code name is ignored.
+  std::vector<unsigned long long> codes_to_search(1, code);
+  _search_code(codes_to_search, rate_type, generation->reference_time, selected_tables, result);
+  result.resolve_code_names(*generation->code_names);
+}
+
+/**
+    Bulk rating: same as search_code for each code, sharing the traversal work of each partition
+*/
+void Controller::search_codes(const std::vector<unsigned long long> &codes_to_search, trie::rate_type_t rate_type, search::SearchResult &result, bool include_code) {
+  GenerationPin generation_pin(published_generation);
+  p_generation_t generation = generation_pin.get();
+  if (!generation || !result.pin_generation(generation->id))
+    return;
+  std::vector<unsigned long long> partition_codes[3];
+  table_trie_set_t partition_tables[3];
+  for (auto it = codes_to_search.begin(); it != codes_to_search.end(); ++it) {
+    unsigned long long code = *it;
+    table_trie_set_t selected_tables = select_table_trie(code, code < 1000 ? "USA" : "", generation);
+    size_t partition = 2;
+    if (selected_tables.frozen_tables == generation->world_tables_tries)
+      partition = 0;
+    else if (selected_tables.frozen_tables == generation->us_tables_tries)
+      partition = 1;
+    partition_tables[partition] = selected_tables;
+    partition_codes[partition].push_back(code);
+  }
+  for (size_t i = 0; i < 3; ++i)
+    if (!partition_codes[i].empty())
+      _search_code(partition_codes[i], rate_type, generation->reference_time, partition_tables[i], result, NO_CODE_NAME_ID, include_code);
+  result.resolve_code_names(*generation->code_names);
+}
+
+/**
+    Batch lookup: same as search_code for each code, into the result of the same index. One pin
+    covers the batch, and the codes of each partition and rate type are searched together, with a
+    single fan-out over the tables.
+*/
+void Controller::search_code_batch(const code_queries_t &code_queries, const std::vector<search::p_search_result_t> &results) {
+  GenerationPin generation_pin(published_generation);
+  p_generation_t generation = generation_pin.get();
+  if (!generation)
+    return;
+  std::vector<unsigned long long> batch_codes[3][trie::RATE_TYPES_COUNT];
+  std::vector<search::p_search_result_t> batch_results[3][trie::RATE_TYPES_COUNT];
+  table_trie_set_t partition_tables[3];
+  for (size_t i = 0; i < code_queries.size(); ++i) {
+    unsigned long long code = code_queries[i].code;
+    table_trie_set_t selected_tables = select_table_trie(code, code < 1000 ? "USA" : "", generation);
+    size_t partition = 2;
+    if (selected_tables.frozen_tables == generation->world_tables_tries)
+      partition = 0;
+    else if (selected_tables.frozen_tables == generation->us_tables_tries)
+      partition = 1;
+    partition_tables[partition] = selected_tables;
+    batch_codes[partition][code_queries[i].rate_type].push_back(code);
+    batch_results[partition][code_queries[i].rate_type].push_back(results[i]);
+  }
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, 3 * trie::RATE_TYPES_COUNT),
+    [&](const tbb::blocked_range<size_t> &r) {
+      for (size_t i = r.begin(); i != r.end(); ++i) {
+        size_t partition = i / trie::RATE_TYPES_COUNT;
+        size_t rate_type = i % trie::RATE_TYPES_COUNT;
+        if (!batch_codes[partition][rate_type].empty())
+          _search_code_batch(batch_codes[partition][rate_type], (trie::rate_type_t)rate_type, generation->reference_time,
+                             partition_tables[partition], batch_results[partition][rate_type]);
+      }
+    });
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, results.size()),
+    [&](const tbb::blocked_range<size_t> &r) {
+      for (size_t i = r.begin(); i != r.end(); ++i)
+        results[i]->resolve_code_names(*generation->code_names);
+    });
 }
 
 void Controller::search_code_name(std::string &code_name, trie::rate_type_t rate_type, search::SearchResult &result) {
-  mutex_unique_lock_t update_tables_lock(update_tables_mutex);
-  update_tables_holder.wait(update_tables_lock, [&] { return updating_tables == false; });
-  update_tables_lock.unlock();
-  if (!are_tables_available())
+  GenerationPin generation_pin(published_generation);
+  p_generation_t generation = generation_pin.get();
+  if (!generation || !result.pin_generation(generation->id))
     return;
   str_to_upper(code_name);
-  if (codes->find(code_name) == codes->end())
+  uint32_t code_name_id;
+  if (!find_code_name(generation, code_name, code_name_id))
     return;
-  p_code_set_t code_set = (*codes)[code_name]->second;
-  table_trie_set_t selected_tables = select_table_trie(*code_set->begin(), code_name, false);
-  _search_code(*code_set, rate_type, selected_tables, result, code_name);
+  if (generation->code_name_results)
+    generation->code_name_results->insert_into(code_name_id, rate_type, generation->reference_time, result);
+  else
+    _search_code_name(generation, code_name_id, rate_type, result);
+  result.resolve_code_names(*generation->code_names);
 }
 
-void Controller::_search_code(const code_set_t &code_set, trie::rate_type_t rate_type, table_trie_set_t selected_tables, search::SearchResult &result, const std::string &filter_code_name) {
-  /** THIS SHOULD BE NEVER CALLED DIRECTLY BECAUSE IT IS NOT THREAD SAFE */
-  tbb::parallel_for(tbb::blocked_range<size_t>(0, selected_tables.tables_tries->size()),
-    [&](const tbb::blocked_range<size_t> &r)  {
-        for( size_t i = r.begin(); i != r.end(); ++i ) {
-          trie::p_trie_t trie = (*selected_tables.tables_tries)[i];
-          for (auto it = code_set.begin(); it != code_set.end(); ++it) {
-            unsigned long long code = *it;
-            trie->search_code(trie, code, rate_type, reference_time, result, filter_code_name);
-          }
+/**
+    Searches every code of the given code name, keeping the matches of that code name only
+*/
+void Controller::_search_code_name(p_generation_t generation, uint32_t code_name_id, trie::rate_type_t rate_type, search::SearchResult &result) {
+  const CodeNames &code_names = *generation->code_names;
+  if (code_names.codes_begin(code_name_id) == code_names.codes_end(code_name_id))
+    return;
+  std::vector<unsigned long long> codes_to_search(code_names.codes_begin(code_name_id), code_names.codes_end(code_name_id));
+  table_trie_set_t selected_tables = select_table_trie(codes_to_search.front(), code_names.get_code_name(code_name_id), generation);
+  _search_code(codes_to_search, rate_type, generation->reference_time, selected_tables, result, code_name_id);
+}
+
+/**
+    Returns the id of the given code name in the given generation, if it has codes there. A delta
+    load adds code names to the codes of the published generation, only ids below the count of
+    its code names belong to it.
+*/
+bool Controller::find_code_name(p_generation_t generation, const std::string &code_name, uint32_t &code_name_id) {
+  codes_t::const_iterator it = generation->codes->find(code_name);
+  if (it == generation->codes->end())
+    return false;
+  code_name_id = it->second->code_name_id.load(std::memory_order_acquire);
+  return code_name_id < generation->code_names->size() &&
+         generation->code_names->codes_begin(code_name_id) != generation->code_names->codes_end(code_name_id);
+}
+
+void Controller::_search_code(const std::vector<unsigned long long> &codes_to_search, trie::rate_type_t rate_type, time_t reference_time, table_trie_set_t selected_tables, search::SearchResult &result, uint32_t filter_code_name_id, bool include_code) {
+  /** THIS SHOULD BE NEVER CALLED WITHOUT PINNING THE GENERATION OF THE SELECTED TABLES */
+  if (selected_tables.unified_index) {
+    trie::p_unified_index_t unified_index = selected_tables.unified_index;
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, codes_to_search.size()),
+      [&](const tbb::blocked_range<size_t> &r)  {
+        for (size_t i = r.begin(); i != r.end(); ++i)
+          unified_index->search_code(codes_to_search[i], rate_type, reference_time, result, filter_code_name_id, include_code);
+      });
+    return;
+  }
+  tbb::parallel_for(tbb::blocked_range2d<size_t, size_t>(0, selected_tables.frozen_tables->size(), 0, codes_to_search.size()),
+    [&](const tbb::blocked_range2d<size_t, size_t> &r)  {
+      for (size_t i = r.rows().begin(); i != r.rows().end(); ++i) {
+        trie::p_frozen_trie_t trie = (*selected_tables.frozen_tables)[i];
+        trie->search_codes(&codes_to_search[r.cols().begin()], r.cols().size(), rate_type, reference_time, result, filter_code_name_id, include_code);
+      }
+    }
+  );
+}
+
+void Controller::_search_code_batch(const std::vector<unsigned long long> &codes_to_search, trie::rate_type_t rate_type, time_t reference_time, table_trie_set_t selected_tables, const std::vector<search::p_search_result_t> &results) {
+  /** THIS SHOULD BE NEVER CALLED WITHOUT PINNING THE GENERATION OF THE SELECTED TABLES */
+  if (selected_tables.unified_index) {
+    trie::p_unified_index_t unified_index = selected_tables.unified_index;
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, codes_to_search.size()),
+      [&](const tbb::blocked_range<size_t> &r)  {
+        for (size_t i = r.begin(); i != r.end(); ++i)
+          unified_index->search_code(codes_to_search[i], rate_type, reference_time, *results[i]);
+      });
+    return;
+  }
+  tbb::parallel_for(tbb::blocked_range2d<size_t, size_t>(0, selected_tables.frozen_tables->size(), 0, codes_to_search.size()),
+    [&](const tbb::blocked_range2d<size_t, size_t> &r)  {
+      for (size_t i = r.rows().begin(); i != r.rows().end(); ++i) {
+        trie::p_frozen_trie_t trie = (*selected_tables.frozen_tables)[i];
+        trie->search_codes(&codes_to_search[r.cols().begin()], r.cols().size(), rate_type, reference_time, &results[r.cols().begin()]);
       }
     }
   );
 }
 
 void Controller::search_code_name_rate_table(std::string &code_name, unsigned int rate_table_id, trie::rate_type_t rate_type, search::SearchResult &result, bool include_code) {
-  mutex_unique_lock_t update_tables_lock(update_tables_mutex);
-  update_tables_holder.wait(update_tables_lock, [&] { return updating_tables == false; });
-  update_tables_lock.unlock();
-  if (!are_tables_available())
+  GenerationPin generation_pin(published_generation);
+  p_generation_t generation = generation_pin.get();
+  if (!generation || !result.pin_generation(generation->id))
     return;
   str_to_upper(code_name);
-  if (codes->find(code_name) == codes->end())
+  uint32_t code_name_id;
+  if (!find_code_name(generation, code_name, code_name_id))
     return;
-  p_code_set_t code_set = (*codes)[code_name]->second;
-  table_trie_set_t selected_tables = select_table_trie(*code_set->begin(), code_name, false);
-  if (selected_tables.tables_index->find(rate_table_id) == selected_tables.tables_index->end())
+  const unsigned long long *codes_begin = generation->code_names->codes_begin(code_name_id);
+  const unsigned long long *codes_end = generation->code_names->codes_end(code_name_id);
+  table_trie_set_t selected_tables = select_table_trie(*codes_begin, code_name, generation);
+  tables_index_t::const_iterator index_it = selected_tables.tables_index->find(rate_table_id);
+  if (index_it == selected_tables.tables_index->end())
     return;
-  size_t index = (*selected_tables.tables_index)[rate_table_id];
-  trie::p_trie_t trie = (*selected_tables.tables_tries)[index];
-  for (auto it = code_set->begin(); it != code_set->end(); ++it) {
-    unsigned long long code = *it;
-    trie->search_code(trie, code, rate_type, reference_time, result, code_name, include_code);
-  }
+  trie::p_frozen_trie_t trie = (*selected_tables.frozen_tables)[index_it->second];
+  trie->search_codes(codes_begin, codes_end - codes_begin, rate_type, generation->reference_time, result, code_name_id, include_code);
+  result.resolve_code_names(*generation->code_names);
 }
 
 void Controller::search_rate_table(unsigned int rate_table_id, trie::rate_type_t rate_type, search::SearchResult &result) {
-  mutex_unique_lock_t update_tables_lock(update_tables_mutex);
-  update_tables_holder.wait(update_tables_lock, [&] { return updating_tables == false; });
-  update_tables_lock.unlock();
-  p_tables_index_t tables_index;
-  p_tables_tries_t tables_tries;
-  if (!are_tables_available())
+  GenerationPin generation_pin(published_generation);
+  p_generation_t generation = generation_pin.get();
+  if (!generation || !result.pin_generation(generation->id))
     return;
-  std::vector<p_code_set_t> all_codes_sets;
-  for (auto it = codes->begin(); it != codes->end(); ++it)
-    all_codes_sets.push_back(it->second->second);
-  tbb::parallel_for(tbb::blocked_range2d<size_t, size_t>(0, 3, 0, all_codes_sets.size()),
+  const std::vector<unsigned long long> &all_codes = generation->code_names->get_all_codes();
+  tbb::parallel_for(tbb::blocked_range2d<size_t, size_t>(0, 3, 0, all_codes.size()),
     [&](const tbb::blocked_range2d<size_t, size_t> &r){
       for (size_t i = r.rows().begin(); i != r.rows().end(); ++i) {
+        p_tables_index_t tables_index;
+        p_frozen_tables_t tables_tries;
         switch (i) {
           case 0:
-            tables_index = world_tables_index;
-            tables_tries = world_tables_tries;
+            tables_index = generation->world_tables_index;
+            tables_tries = generation->world_tables_tries;
             break;
           case 1:
-            tables_index = us_tables_index;
-            tables_tries = us_tables_tries;
+            tables_index = generation->us_tables_index;
+            tables_tries = generation->us_tables_tries;
             break;
-          case 2:
-            tables_index = az_tables_index;
-            tables_tries = az_tables_tries;
+          default:
+            tables_index = generation->az_tables_index;
+            tables_tries = generation->az_tables_tries;
           break;
         }
-        if (tables_index->find(rate_table_id) == tables_index->end())
+        tables_index_t::const_iterator index_it = tables_index->find(rate_table_id);
+        if (index_it == tables_index->end())
           continue;
-        size_t index = (*tables_index)[rate_table_id];
-        trie::p_trie_t trie = (*tables_tries)[index];
-        for (size_t j = r.cols().begin(); j != r.cols().end(); ++j) {
-          p_code_set_t code_set = all_codes_sets[j];
-          for (auto it = code_set->begin(); it != code_set->end(); ++it) {
-            unsigned long long code = *it;
-            trie->search_code(trie, code, rate_type, reference_time, result);
-          }
-        }
+        trie::p_frozen_trie_t trie = (*tables_tries)[index_it->second];
+        trie->search_codes(&all_codes[r.cols().begin()], r.cols().size(), rate_type, generation->reference_time, result);
       }
     });
-  all_codes_sets.clear();
+  result.resolve_code_names(*generation->code_names);
 }
 
 void Controller::search_all_codes(trie::rate_type_t rate_type, search::SearchResult &result) {
-  mutex_unique_lock_t update_tables_lock(update_tables_mutex);
-  update_tables_holder.wait(update_tables_lock, [&] { return updating_tables == false; });
-  update_tables_lock.unlock();
-  if (!are_tables_available())
+  GenerationPin generation_pin(published_generation);
+  p_generation_t generation = generation_pin.get();
+  if (!generation || !result.pin_generation(generation->id))
     return;
   //p_tables_index_t tables_index;
-  p_tables_tries_t tables_tries;
-  std::set<unsigned long long > all_codes;
-  for (auto it = codes->begin(); it != codes->end(); ++it) {
-    p_code_set_t code_set = it->second->second;
-    all_codes.insert(code_set->begin(), code_set->end());
-  }
+  p_frozen_tables_t tables_tries;
+  std::vector<unsigned long long> codes_to_search(generation->code_names->get_all_codes());
+  std::sort(codes_to_search.begin(), codes_to_search.end());
+  codes_to_search.erase(std::unique(codes_to_search.begin(), codes_to_search.end()), codes_to_search.end());
   /*tbb::parallel_for(tbb::blocked_range<size_t>(0, 3),
     [&](const tbb::blocked_range<size_t> &r)  {
       for (auto i = r.begin(); i != r.end(); ++i) {
@@ -464,20 +911,27 @@ void Controller::search_all_codes(trie::rate_type_t rate_type, search::SearchRes
             break;
           case 2:*/
             //tables_index = az_tables_index;
-            tables_tries = az_tables_tries;
+            tables_tries = generation->az_tables_tries;
           /*break;
         }*/
-        tbb::parallel_for(tbb::blocked_range<size_t>(0, tables_tries->size()),
-          [&](const tbb::blocked_range<size_t> &s)  {
-            for (auto j = s.begin(); j != s.end(); ++j) {
-              trie::p_trie_t trie = (*tables_tries)[j];
-              for (auto it=all_codes.begin(); it != all_codes.end(); ++it) {
-                unsigned long long code = *it;
-                trie->search_code(trie, code, rate_type, reference_time, result);
-              }
+        trie::p_unified_index_t az_unified_index = generation->az_unified_index;
+        if (az_unified_index) {
+          tbb::parallel_for(tbb::blocked_range<size_t>(0, codes_to_search.size()),
+            [&](const tbb::blocked_range<size_t> &s)  {
+              for (auto j = s.begin(); j != s.end(); ++j)
+                az_unified_index->search_code(codes_to_search[j], rate_type, generation->reference_time, result);
+            });
+          result.resolve_code_names(*generation->code_names);
+          return;
+        }
+        tbb::parallel_for(tbb::blocked_range2d<size_t, size_t>(0, tables_tries->size(), 0, codes_to_search.size()),
+          [&](const tbb::blocked_range2d<size_t, size_t> &s)  {
+            for (auto j = s.rows().begin(); j != s.rows().end(); ++j) {
+              trie::p_frozen_trie_t trie = (*tables_tries)[j];
+              trie->search_codes(&codes_to_search[s.cols().begin()], s.cols().size(), rate_type, generation->reference_time, result);
             }
           });
       //}
    //});
-   all_codes.clear();
+   result.resolve_code_names(*generation->code_names);
 }
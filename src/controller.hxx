@@ -3,55 +3,56 @@
 
 #include "db.hxx"
 #include "trie.hxx"
+#include "frozen_trie.hxx"
+#include "unified_index.hxx"
+#include "load_shard.hxx"
+#include "generation.hxx"
 #include "search_result.hxx"
 #include "shared.hxx"
 #include <vector>
+#include <string>
 #include <atomic>
-#include <condition_variable>
 
 namespace ctrl {
 
   class Controller;
+  class ControllerOptions;
   typedef Controller* p_controller_t;
+  typedef ControllerOptions* p_controller_options_t;
+
+  class ControllerOptions {
+    public:
+      unsigned int telnet_listen_port;
+      unsigned int http_listen_port;
+      bool unified_index;
+      unsigned char trie_stride;
+      unsigned char jump_digits;
+      bool sharded_load;
+      bool huge_pages;
+      unsigned int full_reload_every;
+      std::string snapshot_path;
+      bool pipelined_load;
+      bool code_name_results;
+  };
 
   class Controller {
     private:
-      typedef tbb::concurrent_unordered_map<unsigned int, size_t> tables_index_t;
       typedef tbb::concurrent_vector<trie::p_trie_t> tables_tries_t;
-      typedef tables_index_t* p_tables_index_t;
       typedef tables_tries_t* p_tables_tries_t;
       typedef struct {
         p_tables_tries_t tables_tries;
+        p_frozen_tables_t frozen_tables;
+        trie::p_unified_index_t unified_index;
         p_tables_index_t tables_index;
-        tbb::mutex* table_index_insertion_mutex;
       } table_trie_set_t;
-      typedef tbb::concurrent_unordered_map<std::string, p_code_value_t> codes_t;
-      typedef codes_t* p_codes_t;
-      typedef std::unique_lock<std::mutex> mutex_unique_lock_t;
-      typedef tbb::concurrent_queue<trie::p_trie_t> trie_release_queue_t;
-      typedef tbb::concurrent_queue<p_code_value_t> code_release_queue_t;
-      typedef trie_release_queue_t* p_trie_release_queue_t;
-      typedef code_release_queue_t* p_code_release_queue_t;
-      typedef tbb::concurrent_vector<trie_release_queue_t*> tries_release_queues_t;
-      typedef tbb::concurrent_vector<p_code_release_queue_t> codes_release_queues_t;
-      tries_release_queues_t tries_release_queues;
-      codes_release_queues_t codes_release_queues;
+      typedef tbb::concurrent_vector<p_load_shard_t> load_shards_t;
+      arenas_t load_arenas;
+      load_shards_t load_shards;
       time_t reference_time;
-      tbb::mutex world_table_index_insertion_mutex;
-      tbb::mutex us_table_index_insertion_mutex;
-      tbb::mutex az_table_index_insertion_mutex;
-      tbb::mutex code_name_creation_mutex;
-      std::mutex update_tables_mutex;
-      std::condition_variable update_tables_holder;
+      PublishedGeneration published_generation;
       db::p_db_t database;
       db::p_conn_info_t conn_info;
-      p_tables_tries_t world_tables_tries;
-      p_tables_index_t world_tables_index;
-      p_tables_tries_t us_tables_tries;
-      p_tables_index_t us_tables_index;
-      p_tables_tries_t az_tables_tries;
-      p_tables_index_t az_tables_index;
-      p_codes_t codes;
+      p_controller_options_t options;
       p_tables_tries_t new_world_tables_tries;
       p_tables_index_t new_world_tables_index;
       p_tables_tries_t new_us_tables_tries;
@@ -59,43 +60,63 @@ namespace ctrl {
       p_tables_tries_t new_az_tables_tries;
       p_tables_index_t new_az_tables_index;
       p_codes_t new_codes;
-      p_tables_tries_t old_world_tables_tries;
-      p_tables_index_t old_world_tables_index;
-      p_tables_tries_t old_us_tables_tries;
-      p_tables_index_t old_us_tables_index;
-      p_tables_tries_t old_az_tables_tries;
-      p_tables_index_t old_az_tables_index;
-      p_codes_t old_codes;
-      unsigned int telnet_listen_port;
-      unsigned int http_listen_port;
-      std::atomic_bool updating_tables;
-      std::atomic_bool clearing_tables;
+      p_code_names_t new_code_names;
+      p_arenas_t new_codes_arenas;
+      p_frozen_tables_t new_world_frozen_tables;
+      p_frozen_tables_t new_us_frozen_tables;
+      p_frozen_tables_t new_az_frozen_tables;
+      trie::p_unified_index_t new_world_unified_index;
+      trie::p_unified_index_t new_us_unified_index;
+      trie::p_unified_index_t new_az_unified_index;
+      p_generation_t loaded_generation;
+      unsigned int loaded_rate_id;
+      unsigned int delta_loads_count;
+      std::atomic_bool delta_load;
+      std::atomic<unsigned long long> code_name_creation_races;
+      std::atomic<unsigned long long> table_creation_races;
       void run_worker(unsigned int worker_index);
       void run_logger();
       void run_http_server();
       void run_telnet_server();
+      p_arenas_t create_arenas();
       void reset_new_tables();
+      void start_load_cicle();
+      void release_load_tables();
+      p_frozen_tables_t freeze_tables(p_tables_tries_t tables_tries, p_tables_index_t tables_index);
+      p_code_pair_t find_or_insert_code_name(const std::string &code_name, unsigned int worker_index);
+      trie::p_trie_t find_or_insert_table_trie(table_trie_set_t &selected_tables, unsigned int rate_table_id, unsigned int worker_index);
+      void log_insertion_races();
+      void log_clamped_rates();
+      trie::p_unified_index_t unify_tables(p_frozen_tables_t frozen_tables);
+      void restride_tables(p_frozen_tables_t frozen_tables);
+      void inherit_tables(p_frozen_tables_t frozen_tables, p_tables_index_t tables_index, p_frozen_tables_t loaded_tables, p_tables_index_t loaded_index);
+      void merge_load_shards();
+      void intern_new_code_names();
+      void freeze_new_tables();
+      void save_snapshot(p_code_names_t code_names, p_frozen_tables_t world_tables, p_frozen_tables_t us_tables, p_frozen_tables_t az_tables);
+      void load_snapshot();
       void create_table_tries();
       void update_table_tries();
       void update_rate_tables_tries();
-      void clear_tables();
-      void renew_tables();
+      void run_load_pipeline();
+      void compute_code_name_results(p_generation_t generation);
+      void publish_new_tables();
       void insert_code_name_rate_table_db();
-      table_trie_set_t select_table_trie(unsigned long long code, const std::string &code_name, bool inserting);
-      bool are_tables_available();
-      void _search_code(const code_set_t &code_set, trie::rate_type_t rate_type, table_trie_set_t selected_tables, search::SearchResult &result, const std::string &filter_code_name = "");
-      Controller(db::ConnectionInfo &conn_info,
-                 unsigned int telnet_listen_port,
-                 unsigned int http_listen_port);
+      table_trie_set_t select_table_trie(unsigned long long code, const std::string &code_name, p_generation_t generation);
+      bool find_code_name(p_generation_t generation, const std::string &code_name, uint32_t &code_name_id);
+      void _search_code_name(p_generation_t generation, uint32_t code_name_id, trie::rate_type_t rate_type, search::SearchResult &result);
+      void _search_code(const std::vector<unsigned long long> &codes_to_search, trie::rate_type_t rate_type, time_t reference_time, table_trie_set_t selected_tables, search::SearchResult &result, uint32_t filter_code_name_id = NO_CODE_NAME_ID, bool include_code = false);
+      void _search_code_batch(const std::vector<unsigned long long> &codes_to_search, trie::rate_type_t rate_type, time_t reference_time, table_trie_set_t selected_tables, const std::vector<search::p_search_result_t> &results);
+      Controller(db::ConnectionInfo &conn_info, ControllerOptions &options);
       ~Controller();
     public:
-      static p_controller_t get_controller(db::ConnectionInfo &conn_info,
-                                        unsigned int telnet_listen_port,
-                                        unsigned int http_listen_port);
+      static p_controller_t get_controller(db::ConnectionInfo &conn_info, ControllerOptions &options);
       static p_controller_t get_controller();
       void start_workflow();
       void insert_new_rate_data(db::db_data_t db_data);
       void search_code(unsigned long long code, trie::rate_type_t rate_type, search::SearchResult &result);
+      void search_codes(const std::vector<unsigned long long> &codes_to_search, trie::rate_type_t rate_type, search::SearchResult &result, bool include_code = false);
+      void search_code_batch(const code_queries_t &code_queries, const std::vector<search::p_search_result_t> &results);
       void search_code_name(std::string &code_name, trie::rate_type_t rate_type, search::SearchResult &result);
       void search_code_name_rate_table(std::string &code_name, unsigned int rate_table_id, trie::rate_type_t rate_type, search::SearchResult &result, bool include_code = false);
       void search_rate_table(unsigned int rate_table_id, trie::rate_type_t rate_type, search::SearchResult &result);
@@ -0,0 +1,183 @@
+#include "copy_reader.hxx"
+#include "exceptions.hxx"
+#include <cstring>
+#include <endian.h>
+
+using namespace db;
+
+const char CopyReader::SIGNATURE[11] = {'P', 'G', 'C', 'O', 'P', 'Y', '\n', '\377', '\r', '\n', '\0'};
+
+/**
+    Starts the given COPY statement, which must write to STDOUT in binary format
+*/
+CopyReader::CopyReader(PGconn *connection, const std::string &query)
+  : connection(connection), row_buffer(nullptr), header_read(false), finished(false), fields_count(0)
+{
+  PGresult *result = PQexec(connection, query.c_str());
+  ExecStatusType status = PQresultStatus(result);
+  PQclear(result);
+  if (status != PGRES_COPY_OUT)
+    throw DBCopyFailedException();
+}
+
+/**
+    Drains the rest of the COPY, if it was left before its end, so the connection can be reused
+*/
+CopyReader::~CopyReader() {
+  if (row_buffer)
+    PQfreemem(row_buffer);
+  if (!finished) {
+    char *buffer;
+    while (PQgetCopyData(connection, &buffer, 0) > 0)
+      PQfreemem(buffer);
+    PGresult *result;
+    while ((result = PQgetResult(connection)))
+      PQclear(result);
+  }
+}
+
+/**
+    Reads the final status of the COPY once its data is over
+*/
+void CopyReader::finish() {
+  finished = true;
+  bool failed = false;
+  PGresult *result;
+  while ((result = PQgetResult(connection))) {
+    if (PQresultStatus(result) != PGRES_COMMAND_OK)
+      failed = true;
+    PQclear(result);
+  }
+  if (failed)
+    throw DBCopyFailedException();
+}
+
+/**
+    Moves to the next row, returns false at the end of the data
+*/
+bool CopyReader::next_row() {
+  if (finished)
+    return false;
+  if (row_buffer) {
+    PQfreemem(row_buffer);
+    row_buffer = nullptr;
+  }
+  int row_size = PQgetCopyData(connection, &row_buffer, 0);
+  if (row_size == -1) {
+    finish();
+    return false;
+  }
+  if (row_size < 0)
+    throw DBCopyFailedException();
+  const char *position = row_buffer;
+  const char *row_end = row_buffer + row_size;
+  if (!header_read) {
+    if (row_size < (int)sizeof(SIGNATURE) + 8 || memcmp(position, SIGNATURE, sizeof(SIGNATURE)) != 0)
+      throw DBCopyFormatException();
+    position += sizeof(SIGNATURE) + 4;
+    uint32_t extension_length;
+    memcpy(&extension_length, position, 4);
+    extension_length = be32toh(extension_length);
+    position += 4;
+    if (extension_length > (size_t)(row_end - position))
+      throw DBCopyFormatException();
+    position += extension_length;
+    header_read = true;
+  }
+  if (row_end - position < 2)
+    throw DBCopyFormatException();
+  uint16_t tuple_fields;
+  memcpy(&tuple_fields, position, 2);
+  position += 2;
+  int16_t count = be16toh(tuple_fields);
+  if (count == -1) {
+    PQfreemem(row_buffer);
+    row_buffer = nullptr;
+    char *buffer;
+    while (PQgetCopyData(connection, &buffer, 0) > 0)
+      PQfreemem(buffer);
+    finish();
+    return false;
+  }
+  if (count < 0 || count > (int16_t)MAX_FIELDS)
+    throw DBCopyFormatException();
+  fields_count = count;
+  for (unsigned int i = 0; i < fields_count; ++i) {
+    if (row_end - position < 4)
+      throw DBCopyFormatException();
+    uint32_t field_length;
+    memcpy(&field_length, position, 4);
+    position += 4;
+    fields[i].length = be32toh(field_length);
+    fields[i].data = position;
+    if (fields[i].length > 0) {
+      if (fields[i].length > row_end - position)
+        throw DBCopyFormatException();
+      position += fields[i].length;
+    }
+  }
+  return true;
+}
+
+unsigned int CopyReader::size() const {
+  return fields_count;
+}
+
+bool CopyReader::is_null(unsigned int index) const {
+  return index >= fields_count || fields[index].length == -1;
+}
+
+/**
+    Throws unless the field exists and has the given length
+*/
+void CopyReader::check_field(unsigned int index, int32_t length) const {
+  if (index >= fields_count || fields[index].length != length)
+    throw DBCopyFormatException();
+}
+
+int32_t CopyReader::get_int32(unsigned int index) const {
+  check_field(index, 4);
+  uint32_t value;
+  memcpy(&value, fields[index].data, 4);
+  return be32toh(value);
+}
+
+int64_t CopyReader::get_int64(unsigned int index) const {
+  check_field(index, 8);
+  uint64_t value;
+  memcpy(&value, fields[index].data, 8);
+  return be64toh(value);
+}
+
+/**
+    Reads an int2, int4 or int8 field, telling them apart by their length
+*/
+int64_t CopyReader::get_integer(unsigned int index) const {
+  if (index >= fields_count)
+    throw DBCopyFormatException();
+  if (fields[index].length == 8)
+    return get_int64(index);
+  if (fields[index].length == 4)
+    return get_int32(index);
+  check_field(index, 2);
+  uint16_t value;
+  memcpy(&value, fields[index].data, 2);
+  return (int16_t)be16toh(value);
+}
+
+double CopyReader::get_float8(unsigned int index) const {
+  uint64_t bits = get_int64(index);
+  double value;
+  memcpy(&value, &bits, 8);
+  return value;
+}
+
+/**
+    Points at the bytes of a text field, valid until the next row is read
+*/
+const char *CopyReader::get_text(unsigned int index, size_t &length) const {
+  if (index >= fields_count || fields[index].length < 0)
+    throw DBCopyFormatException();
+  length = fields[index].length;
+  return fields[index].data;
+}
@@ -0,0 +1,51 @@
+/**
+      Reader of the rows of a COPY ... TO STDOUT (FORMAT binary) statement
+*/
+#ifndef COPY_READER_HXX
+#define COPY_READER_HXX
+
+#include <libpq-fe.h>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace db {
+
+  class CopyReader;
+  typedef CopyReader* p_copy_reader_t;
+
+  /**
+      Decodes the binary tuples straight from the buffers libpq returns, one row per buffer:
+      fields are big endian values prefixed by their length (-1 for NULL), and the stream starts
+      with a signature, flags and a header extension, prepended to the first row.
+  */
+  class CopyReader {
+    private:
+      typedef struct {
+        const char *data;
+        int32_t length;
+      } field_t;
+      static const char SIGNATURE[11];
+      static const unsigned int MAX_FIELDS = 16;
+      PGconn *connection;
+      char *row_buffer;
+      bool header_read;
+      bool finished;
+      unsigned int fields_count;
+      field_t fields[MAX_FIELDS];
+      void check_field(unsigned int index, int32_t length) const;
+      void finish();
+    public:
+      CopyReader(PGconn *connection, const std::string &query);
+      ~CopyReader();
+      bool next_row();
+      unsigned int size() const;
+      bool is_null(unsigned int index) const;
+      int32_t get_int32(unsigned int index) const;
+      int64_t get_int64(unsigned int index) const;
+      int64_t get_integer(unsigned int index) const;
+      double get_float8(unsigned int index) const;
+      const char *get_text(unsigned int index, size_t &length) const;
+  };
+}
+#endif
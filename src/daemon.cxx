@@ -21,8 +21,19 @@ int main(int argc, char *argv[]) {
     unsigned int last_row_to_read_debug = 0;
     unsigned int refresh_minutes = 30;
     unsigned int chunk_size = 100000;
+    bool unified_index = false;
+    unsigned int trie_stride = 1;
+    unsigned int jump_digits = 4;
+    bool sharded_load = false;
+    bool huge_pages = false;
+    unsigned int full_reload_every = 1;
+    std::string snapshot_path = "";
+    bool binary_copy = false;
+    bool pipelined_load = false;
+    unsigned int fetch_size = 0;
+    bool code_name_results = false;
 
-    while ((opt = getopt(argc, argv, "c:d:u:p:s:n:t:w:f:l:m:k:h")) != -1) {
+    while ((opt = getopt(argc, argv, "c:d:u:p:s:n:t:w:f:l:m:k:xr:j:bgi:o:yez:ah")) != -1) {
        switch (opt) {
        case 'c':
           dbhost = std::string(optarg);
@@ -60,10 +71,54 @@ int main(int argc, char *argv[]) {
        case 'k':
           chunk_size = atoi(optarg);
           break;
+       case 'x':
+          unified_index = true;
+          break;
+       case 'r':
+          trie_stride = atoi(optarg);
+          break;
+       case 'j':
+          jump_digits = atoi(optarg);
+          break;
+       case 'b':
+          sharded_load = true;
+          break;
+       case 'g':
+          huge_pages = true;
+          break;
+       case 'i':
+          full_reload_every = atoi(optarg);
+          break;
+       case 'o':
+          snapshot_path = std::string(optarg);
+          break;
+       case 'y':
+          binary_copy = true;
+          break;
+       case 'e':
+          pipelined_load = true;
+          break;
+       case 'z':
+          fetch_size = atoi(optarg);
+          break;
+       case 'a':
+          code_name_results = true;
+          break;
        default: /* '?' */
            ctrl::error("Usage: " + std::string(argv[0]) + " [-h] [-c dbhost] [-d dbname] [-u dbuser] [-p dbpassword]");
            ctrl::error("          [-s dbport] [-k db_chunk_size] [-t telnet_listen_port] [-w http_listen_port] [-n connections_count]");
            ctrl::error("          [-f first_row_to_read_debug] [-l last_row_to_read_debug] [-m refresh_minutes]");
+           ctrl::error("          [-x (search all rate tables of a partition through one unified index)]");
+           ctrl::error("          [-r trie_stride (digits per prefix tree level: 1, 2 or 3)]");
+           ctrl::error("          [-j jump_digits (leading digits directly indexed, 0 to disable)]");
+           ctrl::error("          [-b (load each connection into a private shard, merged at the end of the load)]");
+           ctrl::error("          [-g (back the loading memory arenas with transparent huge pages)]");
+           ctrl::error("          [-i full_reload_every (delta loads of the new rate rows in between full loads, 1 to disable)]");
+           ctrl::error("          [-o snapshot_path (served on startup until the first load is done, rewritten after every load, once published with a stride of 1)]");
+           ctrl::error("          [-y (read the rate rows with binary COPY, through one more connection per loader)]");
+           ctrl::error("          [-e (pipelined load: fetching, parsing and insertion overlap, insertion on every core)]");
+           ctrl::error("          [-z fetch_size (rows read at a time from a server-side cursor and inserted as they arrive, 0 to read whole chunks)]");
+           ctrl::error("          [-a (compute the results of every code name search after each load)]");
            exit(EXIT_FAILURE);
        }
     }
@@ -71,6 +126,26 @@ int main(int argc, char *argv[]) {
       ctrl::error("At least one connection to database is needed to run.");
       exit(EXIT_FAILURE);
     }
+    if (trie_stride < 1 || trie_stride > trie::StrideTrie::MAX_STRIDE) {
+      ctrl::error("Prefix tree stride must be 1, 2 or 3.");
+      exit(EXIT_FAILURE);
+    }
+    if (jump_digits > trie::JumpTable::MAX_JUMP_DIGITS) {
+      ctrl::error("At most " + std::to_string(trie::JumpTable::MAX_JUMP_DIGITS) + " leading digits can be directly indexed.");
+      exit(EXIT_FAILURE);
+    }
+    if (fetch_size > 0 && pipelined_load) {
+      ctrl::error("Pipelined loads read whole chunks: -z can't be used with -e.");
+      exit(EXIT_FAILURE);
+    }
+    if (full_reload_every < 1) {
+      ctrl::error("Full reloads must happen at least every cycle.");
+      exit(EXIT_FAILURE);
+    }
+    if (full_reload_every > 1 && trie_stride > 1) {
+      ctrl::error("Delta loads need one digit per prefix tree level (-r 1).");
+      exit(EXIT_FAILURE);
+    }
     ctrl::log("Starting...");
     db::ConnectionInfo conn_info;
     conn_info.host = dbhost;
@@ -83,12 +158,28 @@ int main(int argc, char *argv[]) {
     conn_info.last_row_to_read_debug = last_row_to_read_debug;
     conn_info.refresh_minutes = refresh_minutes;
     conn_info.chunk_size = chunk_size;
+    conn_info.binary_copy = binary_copy;
+    conn_info.fetch_size = fetch_size;
+    ctrl::ControllerOptions options;
+    options.telnet_listen_port = telnet_listen_port;
+    options.http_listen_port = http_listen_port;
+    options.unified_index = unified_index;
+    options.trie_stride = trie_stride;
+    options.jump_digits = jump_digits;
+    options.sharded_load = sharded_load;
+    options.huge_pages = huge_pages;
+    options.full_reload_every = full_reload_every;
+    options.snapshot_path = snapshot_path;
+    options.pipelined_load = pipelined_load;
+    options.code_name_results = code_name_results;
     unsigned int num_thread = tbb::task_scheduler_init::default_num_threads();
     if (num_thread < connections_count)
       num_thread = connections_count;
+    if (pipelined_load)
+      num_thread = tbb::task_scheduler_init::default_num_threads() + connections_count;   // Fetches block on the network
     tbb::task_scheduler_init scheduler(num_thread);
 
-    ctrl::p_controller_t controller  = ctrl::Controller::get_controller(conn_info, telnet_listen_port, http_listen_port);
+    ctrl::p_controller_t controller  = ctrl::Controller::get_controller(conn_info, options);
     controller->start_workflow();
     return 0;
   } catch (std::exception &e) {
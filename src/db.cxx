@@ -1,4 +1,5 @@
 #include "db.hxx"
+#include "copy_reader.hxx"
 #include "exceptions.hxx"
 #include "controller.hxx"
 #include "logger.hxx"
@@ -7,25 +8,48 @@
 #include <iostream>
 #include <atomic>
 #include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstring>
 
 using namespace db;
 
-DB::DB(ConnectionInfo &conn_info) : reading(false), reading_count(0), reference_time(-1) {
+DB::DB(ConnectionInfo &conn_info) : reading(false), reading_count(0), reference_time(-1), next_free_piece(0), pieces_left(0), piece_rows(0) {
   p_conn_info = &conn_info;
   if (conn_info.conn_count < 1)
     throw DBNoConnectionsException();
   ctrl::log("Connecting to database with " + std::to_string(conn_info.conn_count) + " connections...");
+  std::string conn_string = "host=" + conn_info.host + " dbname=" + conn_info.dbname + " user=" + conn_info.user + " password=" + conn_info.password + " port=" + std::to_string(conn_info.port);
   tbb::parallel_for(tbb::blocked_range<size_t>(0, conn_info.conn_count),
       [=](const tbb::blocked_range<size_t>& r) {
           for (size_t i = r.begin(); i != r.end(); ++i)
-            connections.push_back(new pqxx::connection("host=" + conn_info.host + " dbname=" + conn_info.dbname + " user=" + conn_info.user + " password=" + conn_info.password + " port=" + std::to_string(conn_info.port)));
+            connections.push_back(new pqxx::connection(conn_string));
       });
+  if (conn_info.binary_copy) {
+    for (size_t i = 0; i < conn_info.conn_count; ++i)
+      copy_connections.push_back(PQconnectdb(conn_string.c_str()));
+    for (size_t i = 0; i < copy_connections.size(); ++i)
+      if (PQstatus(copy_connections[i]) != CONNECTION_OK) {
+        ctrl::error(std::string(PQerrorMessage(copy_connections[i])));
+        throw DBCopyFailedException();
+      }
+  }
 }
 
 DB::~DB() {
   for (size_t i = 0; i < connections.size(); ++i)
     delete connections[i];
   connections.clear();
+  for (size_t i = 0; i < copy_connections.size(); ++i)
+    PQfinish(copy_connections[i]);
+  copy_connections.clear();
+}
+
+/**
+    Last rate_id of the current load cycle
+*/
+unsigned int DB::get_last_rate_id() {
+  return last_rate_id;
 }
 
 bool DB::is_reading() {
@@ -46,10 +70,15 @@ unsigned int DB::get_first_rate_id(bool from_beginning) {
   return ret_val;
 }
 
-void DB::init_load_cicle(time_t reference_time) {
+/**
+    Starts reading every rate row, or only the rows after the given rate_id (delta load)
+*/
+void DB::init_load_cicle(time_t reference_time, unsigned int after_rate_id) {
   ctrl::log("Loading rate records from the database in parallel... ");
   this->reference_time = reference_time;
-  if (p_conn_info->first_row_to_read_debug)
+  if (after_rate_id)
+    first_rate_id = after_rate_id + 1;
+  else if (p_conn_info->first_row_to_read_debug)
     first_rate_id = p_conn_info->first_row_to_read_debug;
   else
     first_rate_id = get_first_rate_id();
@@ -59,66 +88,195 @@ void DB::init_load_cicle(time_t reference_time) {
     last_rate_id = get_first_rate_id(false);
   ctrl::log("DB rate first_rate_id: " + std::to_string(first_rate_id));
   ctrl::log("DB rate last_rate_id: " + std::to_string(last_rate_id));
-  last_queried_row = first_rate_id - 1;
-  reading = true;
   reading_count = 0;
+  split_ranges();
+  reading = pieces_left > 0;
+}
+
+/**
+    Splits the rate_ids to read into pieces of about chunk_size / PIECES_PER_RANGE rate rows, from
+    every n-th rate_id, so sparse or skewed rate_ids still give pieces of similar sizes. If the
+    sampling query fails, pieces hold as many rate_ids instead.
+*/
+void DB::split_ranges() {
+  pieces.clear();
+  claims.assign(p_conn_info->conn_count, piece_claim_t());
+  next_free_piece = 0;
+  pieces_left = 0;
+  piece_rows = p_conn_info->chunk_size / PIECES_PER_RANGE > 0 ? p_conn_info->chunk_size / PIECES_PER_RANGE : 1;
+  if (first_rate_id > last_rate_id)
+    return;
+  std::vector<unsigned int> bounds;
+  try {
+    pqxx::work transaction(*connections[0]);
+    std::string query;
+    query =  "select rate_id from (select rate_id, row_number() over (order by rate_id) as row_number from rate ";
+    query += "where rate_id between " + std::to_string(first_rate_id) + " and " + std::to_string(last_rate_id);
+    query += " and (end_date is null or end_date > to_timestamp(" + std::to_string(reference_time) + "))) as numbered_rates ";
+    query += "where row_number % " + std::to_string(piece_rows) + " = 0 order by rate_id";
+    pqxx::result result = transaction.exec(query);
+    transaction.commit();
+    for (pqxx::result::const_iterator row = result.begin(); row != result.end(); ++row)
+      bounds.push_back(row[0].as<unsigned int>());
+  } catch (std::exception &e) {
+    ctrl::error(std::string(e.what()));
+    ctrl::error("Sampling of the rate_ids failed, reading ranges of " + std::to_string(piece_rows) + " rate_ids.");
+    bounds.clear();
+    for (unsigned long long bound = first_rate_id + piece_rows - 1; bound < last_rate_id; bound += piece_rows)
+      bounds.push_back(bound);
+  }
+  rate_range_t piece;
+  piece.first_rate_id = first_rate_id;
+  for (auto it = bounds.begin(); it != bounds.end(); ++it) {
+    if (*it < piece.first_rate_id || *it >= last_rate_id)
+      continue;
+    piece.last_rate_id = *it;
+    pieces.push_back(piece);
+    piece.first_rate_id = *it + 1;
+  }
+  piece.last_rate_id = last_rate_id;
+  pieces.push_back(piece);
+  pieces_left = pieces.size();
+  ctrl::log("Rate rows split into " + std::to_string(pieces.size()) + " pieces of about " + std::to_string(piece_rows) + " rows.");
 }
 
+/**
+    Reads the next piece of the connection: the next one of the range it claimed, or else the
+    pieces of the next free range, or else the second half of the range with most pieces left
+*/
 void DB::read_chunk(unsigned int conn_index) {
   reading_count++;
-  unsigned long long chunk_size = p_conn_info->chunk_size;
   unsigned int range_first_rate_id;
   unsigned int range_last_rate_id;
-  {
-    tbb::mutex::scoped_lock lock(range_selection_mutex);
-    if (last_queried_row >= last_rate_id) {
-      reading = false;
-      reading_count--;
-      return;
+  if (next_piece(conn_index, range_first_rate_id, range_last_rate_id))
+    query_database(conn_index, piece_rows, range_first_rate_id, range_last_rate_id);
+  reading_count--;
+}
+
+bool DB::next_piece(unsigned int conn_index, unsigned int &range_first_rate_id, unsigned int &range_last_rate_id) {
+  tbb::mutex::scoped_lock lock(range_selection_mutex);
+  piece_claim_t &claim = claims[conn_index];
+  if (claim.next_piece == claim.end_piece) {
+    if (next_free_piece < pieces.size()) {
+      claim.next_piece = next_free_piece;
+      claim.end_piece = std::min(next_free_piece + PIECES_PER_RANGE, pieces.size());
+      next_free_piece = claim.end_piece;
     }
-    range_first_rate_id = last_queried_row + 1;
-    range_last_rate_id = range_first_rate_id + chunk_size;
-    if (range_last_rate_id > last_rate_id) {
-      range_last_rate_id = last_rate_id;
-      reading = false;
+    else {
+      size_t victim = claims.size();
+      for (size_t i = 0; i < claims.size(); ++i)
+        if (claims[i].end_piece - claims[i].next_piece >= 2 &&
+            (victim == claims.size() || claims[i].end_piece - claims[i].next_piece > claims[victim].end_piece - claims[victim].next_piece))
+          victim = i;
+      if (victim == claims.size()) {
+        reading = pieces_left > 0;
+        return false;
+      }
+      claim.end_piece = claims[victim].end_piece;
+      claim.next_piece = claim.end_piece - (claims[victim].end_piece - claims[victim].next_piece) / 2;
+      claims[victim].end_piece = claim.next_piece;
+      ctrl::log("Connection " + std::to_string(conn_index) + " takes over rate_ids " + std::to_string(pieces[claim.next_piece].first_rate_id) +
+                " to " + std::to_string(pieces[claim.end_piece - 1].last_rate_id) + " from connection " + std::to_string(victim) + ".");
     }
-    last_queried_row = range_last_rate_id;
   }
-  query_database(conn_index, chunk_size, range_first_rate_id, range_last_rate_id);
-  reading_count--;
-  reading = last_queried_row < last_rate_id;
+  range_first_rate_id = pieces[claim.next_piece].first_rate_id;
+  range_last_rate_id = pieces[claim.next_piece].last_rate_id;
+  claim.next_piece++;
+  reading = --pieces_left > 0;
+  return true;
+}
+
+/**
+    Takes the next free range of PIECES_PER_RANGE pieces at once (pipelined loads, which keep
+    several ranges in flight instead of stealing), returns false once every piece was taken
+*/
+bool DB::next_range(unsigned int &range_first_rate_id, unsigned int &range_last_rate_id) {
+  tbb::mutex::scoped_lock lock(range_selection_mutex);
+  if (next_free_piece >= pieces.size()) {
+    reading = false;
+    return false;
+  }
+  size_t end_piece = std::min(next_free_piece + PIECES_PER_RANGE, pieces.size());
+  range_first_rate_id = pieces[next_free_piece].first_rate_id;
+  range_last_rate_id = pieces[end_piece - 1].last_rate_id;
+  pieces_left -= end_piece - next_free_piece;
+  next_free_piece = end_piece;
+  reading = pieces_left > 0;
+  return true;
+}
+
+/**
+    Rate rows of the given range still active at the reference time, with their egress trunks, in rate_id order
+*/
+std::string DB::rate_rows_source(unsigned int first_rate_id, unsigned int last_rate_id) {
+  std::string source;
+  source =  "from rate ";
+  //source += "join code using (code) ";
+  source += "join resource using (rate_table_id) ";
+  source += "where resource.active=true and resource.egress=true";
+  source += " and rate_id between " + std::to_string(first_rate_id);
+  source += " and " + std::to_string(last_rate_id);
+  source += " and (end_date is null or end_date > to_timestamp(" + std::to_string(reference_time) + "))";
+  source += " order by rate_id";
+  return source;
+}
+
+std::string DB::rate_rows_select(unsigned int first_rate_id, unsigned int last_rate_id) {
+  std::string query;
+  query =  "select distinct rate_table_id, code, rate, inter_rate, intra_rate, local_rate, ";
+  query += "extract(epoch from effective_date) as effective_date, ";
+  query += "extract(epoch from end_date) as end_date, ";
+  //query += "code.name as code_name, ";
+  query += "code_name, ";
+  query += "resource.resource_id as egress_trunk_id, ";
+  query += "rate_id ";
+  query += rate_rows_source(first_rate_id, last_rate_id);
+  return query;
 }
 
 void DB::query_database(unsigned int conn_index, unsigned long long chunk_size, unsigned int first_rate_id, unsigned int last_rate_id) {
+  ctrl::log("Reading " + std::to_string(chunk_size) + " records through connection: " + std::to_string(conn_index) + ", from rate_id: " + std::to_string(first_rate_id) + " to rate_id: " + std::to_string(last_rate_id));
+  if (p_conn_info->fetch_size) {
+    stream_range(conn_index, first_rate_id, last_rate_id);
+    return;
+  }
+  db_batch_t batch;
+  batch.conn_index = conn_index;
+  batch.first_rate_id = first_rate_id;
+  batch.last_rate_id = last_rate_id;
+  fetch_batch(batch);
+  ctrl::p_controller_t controller = ctrl::Controller::get_controller();
+  if (p_conn_info->binary_copy) {
+    ctrl::log("Inserting " + std::to_string(batch.rows.size()) + " rows copied through connection " + std::to_string(conn_index) + " into memory structure...");
+    for (size_t i = 0; i < batch.rows.size(); ++i)
+      controller->insert_new_rate_data(std::move(batch.rows[i]));
+  }
+  else {
+    ctrl::log("Inserting results from connection " + std::to_string(conn_index) + " into memory structure...");
+    consolidate_results(conn_index, batch.result);
+  }
+}
+
+/**
+    Reads the rate rows of the batch range through the batch connection, retrying failed queries
+*/
+void DB::fetch_batch(db_batch_t &batch) {
   int remaining_retries = 3;
   while (remaining_retries > 0) {
     try {
-      pqxx::work transaction(*connections[conn_index]);
-      ctrl::log("Reading " + std::to_string(chunk_size) + " records through connection: " + std::to_string(conn_index) + ", from rate_id: " + std::to_string(first_rate_id) + " to rate_id: " + std::to_string(last_rate_id));
-      std::string query;
-      query =  "select distinct rate_table_id, code, rate, inter_rate, intra_rate, local_rate, ";
-      query += "extract(epoch from effective_date) as effective_date, ";
-      query += "extract(epoch from end_date) as end_date, ";
-      //query += "code.name as code_name, ";
-      query += "code_name, ";
-      query += "resource.resource_id as egress_trunk_id, ";
-      query += "rate_id ";
-      query += "from rate ";
-      //query += "join code using (code) ";
-      query += "join resource using (rate_table_id) ";
-      query += "where resource.active=true and resource.egress=true";
-      query += " and rate_id between " + transaction.quote(first_rate_id);
-      query += " and " + transaction.quote(last_rate_id);
-      query += " and (end_date is null or end_date > to_timestamp(" + std::to_string(reference_time) + "))";
-      query += " order by rate_id";
-      pqxx::result result = transaction.exec(query);
-      ctrl::log("Inserting results from connection " + std::to_string(conn_index) + " into memory structure...");
-      consolidate_results(conn_index, result);
+      if (p_conn_info->binary_copy)
+        copy_range(batch);
+      else {
+        pqxx::work transaction(*connections[batch.conn_index]);
+        batch.result = transaction.exec(rate_rows_select(batch.first_rate_id, batch.last_rate_id));
+      }
       remaining_retries = -1;
     } catch (std::exception &e) {
       remaining_retries--;
       ctrl::error(std::string(e.what()));
-      ctrl::error("Failed query at connection: " + std::to_string(conn_index) + ". Retrying...");
+      ctrl::error("Failed query at connection: " + std::to_string(batch.conn_index) + ". Retrying...");
+      if (p_conn_info->binary_copy)
+        reset_copy_connection(batch.conn_index);
     }
   }
   if (remaining_retries == 0) {
@@ -126,40 +284,221 @@ void DB::query_database(unsigned int conn_index, unsigned long long chunk_size,
   }
 }
 
-void DB::consolidate_results(unsigned int conn_index, const pqxx::result &result) {
-  for (pqxx::result::const_iterator row = result.begin(); row != result.end(); ++row) {
+/**
+    Turns the fetched pqxx result into rows (rows copied in binary are already parsed)
+*/
+void DB::parse_batch(db_batch_t &batch) {
+  if (p_conn_info->binary_copy)
+    return;
+  batch.rows.reserve(batch.result.size());
+  for (pqxx::result::const_iterator row = batch.result.begin(); row != batch.result.end(); ++row) {
+    db_data_t db_data;
+    if (parse_row(batch.conn_index, row, db_data))
+      batch.rows.push_back(std::move(db_data));
+  }
+  batch.result.clear();
+}
+
+/**
+    Same rules as consolidate_results, without building strings: spaces are ignored and the rest
+    must be the digits of a positive number without leading zeros that fits in 64 bits
+*/
+bool DB::parse_code(const char *text, size_t length, unsigned long long &code) {
+  code = 0;
+  bool has_digits = false;
+  for (size_t i = 0; i < length; ++i) {
+    if (text[i] == ' ')
+      continue;
+    if (text[i] < '0' || text[i] > '9' || (!has_digits && text[i] == '0'))
+      return false;
+    if (__builtin_mul_overflow(code, 10ULL, &code) || __builtin_add_overflow(code, (unsigned long long)(text[i] - '0'), &code))
+      return false;
+    has_digits = true;
+  }
+  return has_digits;
+}
+
+/**
+    Reconnects a COPY connection that was lost (backend restart, network drop), so the next
+    attempt does not run on a dead connection as the pqxx connections would not either
+*/
+void DB::reset_copy_connection(unsigned int conn_index) {
+  PGconn *connection = copy_connections[conn_index];
+  if (PQstatus(connection) == CONNECTION_OK)
+    return;
+  ctrl::error("COPY connection " + std::to_string(conn_index) + " lost, reconnecting...");
+  PQreset(connection);
+  if (PQstatus(connection) != CONNECTION_OK)
+    ctrl::error(std::string(PQerrorMessage(connection)));
+}
+
+/**
+    Reads the range of the batch with a binary COPY, decoding the tuples straight into its rows.
+    The rows are only handed over once the COPY is complete, so a failed COPY can be retried.
+*/
+void DB::copy_range(db_batch_t &batch) {
+  batch.rows.clear();
+  copy_rows(batch.conn_index, batch.first_rate_id, batch.last_rate_id,
+    [&](unsigned int, db_data_t *db_data) {
+      if (db_data)
+        batch.rows.push_back(std::move(*db_data));
+    });
+}
+
+/**
+    Reads a range with a binary COPY, handing each row to the sink as soon as it is decoded
+*/
+void DB::copy_rows(unsigned int conn_index, unsigned int first_rate_id, unsigned int last_rate_id, const db_row_sink_t &row_sink) {
+  std::string query;
+  query =  "copy (select distinct rate_table_id::int4, code::text, ";
+  query += "rate::float8, inter_rate::float8, intra_rate::float8, local_rate::float8, ";
+  query += "extract(epoch from effective_date)::int8 as effective_date, ";
+  query += "extract(epoch from end_date)::int8 as end_date, ";
+  query += "code_name::text, ";
+  query += "resource.resource_id::int4 as egress_trunk_id, ";
+  query += "rate_id ";
+  query += rate_rows_source(first_rate_id, last_rate_id);
+  query += ") to stdout (format binary)";
+  CopyReader copy_reader(copy_connections[conn_index], query);
+  while (copy_reader.next_row()) {
+    unsigned int rate_id = copy_reader.get_integer(10);
     db_data_t db_data;
     db_data.conn_index = conn_index;
-    std::string code_field_text = row[1].as<std::string>();
-    code_field_text.erase(std::remove(code_field_text.begin(), code_field_text.end(), ' '), code_field_text.end()); //Cleaning database mess
-    if (code_field_text == "#VALUE!")  //Ignore database mess
+    size_t code_length;
+    const char *code_text = copy_reader.get_text(1, code_length);
+    if (!parse_code(code_text, code_length, db_data.code)) {
+      if (!(code_length == 7 && memcmp(code_text, "#VALUE!", 7) == 0))  //Ignore database mess
+        ctrl::error("BAD code: " + std::string(code_text, code_length));
+      row_sink(rate_id, nullptr);
       continue;
-    try {
-      db_data.code = std::stoull(code_field_text);
     }
-    catch (std::exception &e) {
-      ctrl::error("BAD code: " + code_field_text);
+    if (copy_reader.is_null(0) || copy_reader.is_null(8) || copy_reader.get_int32(0) == 0) {
+      row_sink(rate_id, nullptr);
       continue;
     }
-    if (db_data.code == 0 || std::to_string(db_data.code) != code_field_text) {
-      ctrl::error("BAD code: " + code_field_text);
-      continue;
+    db_data.rate_table_id = copy_reader.get_int32(0);
+    db_data.default_rate = copy_reader.is_null(2) ? -1 : copy_reader.get_float8(2);
+    db_data.inter_rate = copy_reader.is_null(3) ? -1 : copy_reader.get_float8(3);
+    db_data.intra_rate = copy_reader.is_null(4) ? -1 : copy_reader.get_float8(4);
+    db_data.local_rate = copy_reader.is_null(5) ? -1 : copy_reader.get_float8(5);
+    db_data.effective_date = copy_reader.is_null(6) ? -1 : copy_reader.get_int64(6);
+    db_data.end_date = copy_reader.is_null(7) ? -1 : copy_reader.get_int64(7);
+    size_t code_name_length;
+    const char *code_name = copy_reader.get_text(8, code_name_length);
+    db_data.code_name.assign(code_name, code_name_length);
+    db_data.egress_trunk_id = copy_reader.get_int32(9);
+    row_sink(rate_id, &db_data);
+  }
+}
+
+/**
+    Reads a range through a server-side cursor, fetch_size rows at a time, handing each row to the sink
+*/
+void DB::fetch_rows(unsigned int conn_index, unsigned int first_rate_id, unsigned int last_rate_id, const db_row_sink_t &row_sink) {
+  pqxx::work transaction(*connections[conn_index]);
+  transaction.exec("declare rate_rows no scroll cursor for " + rate_rows_select(first_rate_id, last_rate_id));
+  std::string fetch = "fetch forward " + std::to_string(p_conn_info->fetch_size) + " from rate_rows";
+  while (true) {
+    pqxx::result result = transaction.exec(fetch);
+    if (result.empty())
+      break;
+    for (pqxx::result::const_iterator row = result.begin(); row != result.end(); ++row) {
+      db_data_t db_data;
+      bool valid = parse_row(conn_index, row, db_data);
+      row_sink(row[10].as<unsigned int>(), valid ? &db_data : nullptr);
     }
-    db_data.rate_table_id = row[0].as<unsigned int>();
-    if (db_data.rate_table_id == 0)
-      continue;
-    if (row[8].is_null())
-      continue;
-    db_data.default_rate = row[2].is_null() ? -1 : row[2].as<double>();
-    db_data.inter_rate = row[3].is_null() ? -1 : row[3].as<double>();
-    db_data.intra_rate = row[4].is_null() ? -1 : row[4].as<double>();
-    db_data.local_rate = row[5].is_null() ? -1 : row[5].as<double>();
-    db_data.effective_date = row[6].is_null() ? -1 : row[6].as<time_t>();
-    db_data.end_date = row[7].is_null() ? -1 : row[7].as<time_t>();
-    db_data.code_name = row[8].as<std::string>();
-    db_data.egress_trunk_id = row[9].as<unsigned int>();
-    ctrl::p_controller_t controller = ctrl::Controller::get_controller();
-    controller->insert_new_rate_data(db_data);
+  }
+}
+
+/**
+    Reads a range in small batches (a server-side cursor, or the binary COPY stream) and inserts
+    the rows as they arrive, so memory does not grow with the chunk size. The rows of a rate_id
+    are held back until the next rate_id shows up: a failed read is retried from the rate_id
+    after the last one fully inserted.
+*/
+void DB::stream_range(unsigned int conn_index, unsigned int first_rate_id, unsigned int last_rate_id) {
+  ctrl::p_controller_t controller = ctrl::Controller::get_controller();
+  unsigned int resume_rate_id = first_rate_id;
+  int remaining_retries = 3;
+  while (remaining_retries > 0) {
+    db_rows_t group_rows;
+    bool has_group = false;
+    unsigned int group_rate_id = 0;
+    db_row_sink_t row_sink = [&](unsigned int rate_id, db_data_t *db_data) {
+      if (has_group && rate_id != group_rate_id) {
+        for (size_t i = 0; i < group_rows.size(); ++i)
+          controller->insert_new_rate_data(std::move(group_rows[i]));
+        group_rows.clear();
+        resume_rate_id = group_rate_id + 1;
+      }
+      has_group = true;
+      group_rate_id = rate_id;
+      if (db_data)
+        group_rows.push_back(std::move(*db_data));
+    };
+    try {
+      if (p_conn_info->binary_copy)
+        copy_rows(conn_index, resume_rate_id, last_rate_id, row_sink);
+      else
+        fetch_rows(conn_index, resume_rate_id, last_rate_id, row_sink);
+      for (size_t i = 0; i < group_rows.size(); ++i)
+        controller->insert_new_rate_data(std::move(group_rows[i]));
+      remaining_retries = -1;
+    } catch (std::exception &e) {
+      remaining_retries--;
+      ctrl::error(std::string(e.what()));
+      ctrl::error("Failed query at connection: " + std::to_string(conn_index) + ", resuming from rate_id: " + std::to_string(resume_rate_id) + ". Retrying...");
+      if (p_conn_info->binary_copy)
+        reset_copy_connection(conn_index);
+    }
+  }
+  if (remaining_retries == 0) {
+    throw DBQueryFailedException();
+  }
+}
+
+/**
+    Validates a row of a text query result, returns false if it must be skipped
+*/
+bool DB::parse_row(unsigned int conn_index, const pqxx::result::const_iterator &row, db_data_t &db_data) {
+  db_data.conn_index = conn_index;
+  std::string code_field_text = row[1].as<std::string>();
+  code_field_text.erase(std::remove(code_field_text.begin(), code_field_text.end(), ' '), code_field_text.end()); //Cleaning database mess
+  if (code_field_text == "#VALUE!")  //Ignore database mess
+    return false;
+  try {
+    db_data.code = std::stoull(code_field_text);
+  }
+  catch (std::exception &e) {
+    ctrl::error("BAD code: " + code_field_text);
+    return false;
+  }
+  if (db_data.code == 0 || std::to_string(db_data.code) != code_field_text) {
+    ctrl::error("BAD code: " + code_field_text);
+    return false;
+  }
+  db_data.rate_table_id = row[0].as<unsigned int>();
+  if (db_data.rate_table_id == 0)
+    return false;
+  if (row[8].is_null())
+    return false;
+  db_data.default_rate = row[2].is_null() ? -1 : row[2].as<double>();
+  db_data.inter_rate = row[3].is_null() ? -1 : row[3].as<double>();
+  db_data.intra_rate = row[4].is_null() ? -1 : row[4].as<double>();
+  db_data.local_rate = row[5].is_null() ? -1 : row[5].as<double>();
+  db_data.effective_date = row[6].is_null() ? -1 : row[6].as<time_t>();
+  db_data.end_date = row[7].is_null() ? -1 : row[7].as<time_t>();
+  db_data.code_name = row[8].as<std::string>();
+  db_data.egress_trunk_id = row[9].as<unsigned int>();
+  return true;
+}
+
+void DB::consolidate_results(unsigned int conn_index, const pqxx::result &result) {
+  ctrl::p_controller_t controller = ctrl::Controller::get_controller();
+  for (pqxx::result::const_iterator row = result.begin(); row != result.end(); ++row) {
+    db_data_t db_data;
+    if (parse_row(conn_index, row, db_data))
+      controller->insert_new_rate_data(db_data);
   }
 }
 
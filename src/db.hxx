@@ -3,7 +3,11 @@
 
 #include <tbb/tbb.h>
 #include <pqxx/pqxx>
+#include <libpq-fe.h>
 #include <atomic>
+#include <string>
+#include <vector>
+#include <functional>
 #include "search_result.hxx"
 
 namespace db {
@@ -27,6 +31,22 @@ namespace db {
     unsigned int egress_trunk_id;
   } db_data_t;
   typedef tbb::concurrent_queue<db_data_t> db_queue_t;
+  typedef std::vector<db_data_t> db_rows_t;
+
+  /**
+      Rate rows of a rate_id range read through one connection: fetched as a pqxx result (or,
+      with binary COPY, straight into rows), then parsed into rows
+  */
+  typedef struct {
+    unsigned int conn_index;
+    unsigned int first_rate_id;
+    unsigned int last_rate_id;
+    pqxx::result result;
+    db_rows_t rows;
+  } db_batch_t;
+  typedef db_batch_t* p_db_batch_t;
+  /** Receives each row read with its rate_id, or a null row for a row skipped by validation */
+  typedef std::function<void(unsigned int, db_data_t*)> db_row_sink_t;
 
   class ConnectionInfo {
     public:
@@ -40,31 +60,63 @@ namespace db {
       unsigned int last_row_to_read_debug;
       unsigned int refresh_minutes;
       unsigned long long chunk_size;
+      bool binary_copy;
+      unsigned int fetch_size;
   };
 
   class DB {
     private:
       typedef pqxx::connection* p_connection_t;
       typedef tbb::concurrent_vector<p_connection_t> connections_t;
+      typedef tbb::concurrent_vector<PGconn*> copy_connections_t;
       tbb::mutex range_selection_mutex;
       std::atomic_bool reading;
       std::atomic_uint reading_count;
       time_t reference_time;
       unsigned int first_rate_id;
       unsigned int last_rate_id;
-      std::atomic_uint last_queried_row;
+      typedef struct {
+        unsigned int first_rate_id;
+        unsigned int last_rate_id;
+      } rate_range_t;
+      typedef struct {
+        size_t next_piece;
+        size_t end_piece;
+      } piece_claim_t;
+      std::vector<rate_range_t> pieces;
+      std::vector<piece_claim_t> claims;
+      size_t next_free_piece;
+      std::atomic<size_t> pieces_left;
+      unsigned long long piece_rows;
       p_conn_info_t p_conn_info;
       connections_t connections;
+      copy_connections_t copy_connections;
+      static bool parse_code(const char *text, size_t length, unsigned long long &code);
       unsigned int get_first_rate_id(bool from_beginning=true);
+      void split_ranges();
+      bool next_piece(unsigned int conn_index, unsigned int &range_first_rate_id, unsigned int &range_last_rate_id);
       void query_database(unsigned int conn_index, unsigned long long chunk_size, unsigned int  first_rate_id, unsigned int last_rate_id);
+      std::string rate_rows_source(unsigned int first_rate_id, unsigned int last_rate_id);
+      std::string rate_rows_select(unsigned int first_rate_id, unsigned int last_rate_id);
+      bool parse_row(unsigned int conn_index, const pqxx::result::const_iterator &row, db_data_t &db_data);
       void consolidate_results(unsigned int conn_index, const pqxx::result &result);
+      void reset_copy_connection(unsigned int conn_index);
+      void copy_range(db_batch_t &batch);
+      void copy_rows(unsigned int conn_index, unsigned int first_rate_id, unsigned int last_rate_id, const db_row_sink_t &row_sink);
+      void fetch_rows(unsigned int conn_index, unsigned int first_rate_id, unsigned int last_rate_id, const db_row_sink_t &row_sink);
+      void stream_range(unsigned int conn_index, unsigned int first_rate_id, unsigned int last_rate_id);
     public:
+      static const size_t PIECES_PER_RANGE = 4;
       DB(ConnectionInfo &conn_info);
       ~DB();
-      void init_load_cicle(time_t reference_time);
+      void init_load_cicle(time_t reference_time, unsigned int after_rate_id = 0);
+      unsigned int get_last_rate_id();
       void wait_for_reading();
       void wait_till_next_load_cicle();
       void read_chunk(unsigned int conn_index);
+      bool next_range(unsigned int &range_first_rate_id, unsigned int &range_last_rate_id);
+      void fetch_batch(db_batch_t &batch);
+      void parse_batch(db_batch_t &batch);
       bool is_reading();
       //void insert_code_name_rate_table_rate(const search::SearchResult &search_result);
   };
@@ -0,0 +1,30 @@
+#include "digit_cursor.hxx"
+#include "exceptions.hxx"
+
+using namespace trie;
+
+/**
+    Digits are stored right aligned, so the code is decoded from its least significant digit
+*/
+DigitCursor::DigitCursor(unsigned long long code) {
+  first_position = MAX_CODE_DIGITS;
+  do {
+    digits[--first_position] = code % 10;
+    code /= 10;
+  } while (code != 0);
+  position = first_position;
+}
+
+DigitCursor::DigitCursor(const std::string &code) {
+  if (code.empty())
+    throw TrieInvalidPrefixLengthException();
+  if (code.size() > MAX_CODE_DIGITS)
+    throw TrieCodeTooLongException();
+  first_position = MAX_CODE_DIGITS - code.size();
+  for (size_t i = 0; i < code.size(); ++i) {
+    if (code[i] < '0' || code[i] > '9')
+      throw TrieInvalidPrefixDigitException();
+    digits[first_position + i] = code[i] - '0';
+  }
+  position = first_position;
+}
@@ -0,0 +1,50 @@
+/**
+      Cursor over the decimal digits of a code, most significant first
+*/
+#ifndef DIGIT_CURSOR_HXX
+#define DIGIT_CURSOR_HXX
+
+#include <string>
+
+namespace trie {
+
+  const unsigned char MAX_CODE_DIGITS = 20;      // Digits of the largest unsigned long long
+
+  /**
+      Digits are decoded once at construction (integer division only, no floating point), so
+      embedded zeros need no bookkeeping. A code given as a digit string keeps its leading zeros.
+  */
+  class DigitCursor {
+    private:
+      unsigned char digits[MAX_CODE_DIGITS];
+      unsigned char first_position;
+      unsigned char position;
+    public:
+      DigitCursor(unsigned long long code);
+      DigitCursor(const std::string &code);
+      bool has_more_digits() const;
+      unsigned char next_digit();
+      unsigned char size() const;
+      unsigned char get_digit(unsigned char index) const;
+  };
+
+  inline bool DigitCursor::has_more_digits() const {
+    return position < MAX_CODE_DIGITS;
+  }
+
+  /** Only valid while has_more_digits() is true */
+  inline unsigned char DigitCursor::next_digit() {
+    return digits[position++];
+  }
+
+  inline unsigned char DigitCursor::size() const {
+    return MAX_CODE_DIGITS - first_position;
+  }
+
+  /** Digit at the given index, counting from the most significant one */
+  inline unsigned char DigitCursor::get_digit(unsigned char index) const {
+    return digits[first_position + index];
+  }
+}
+
+#endif
@@ -9,6 +9,13 @@ class TrieInvalidPrefixLengthException : public std::exception {
     }
 };
 
+class TrieCodeTooLongException : public std::exception {
+  virtual const char* what() const throw()
+    {
+      return "Code too long: at most 20 digits are supported in a prefix tree";
+    }
+};
+
 class TrieInvalidPrefixDigitException : public std::exception {
   virtual const char* what() const throw()
     {
@@ -30,6 +37,20 @@ class TrieMissingChildException : public std::exception {
     }
 };
 
+class TrieInvalidStrideException : public std::exception {
+  virtual const char* what() const throw()
+    {
+      return "Prefix tree stride out of range: must be a number between 1 and 3";
+    }
+};
+
+class TrieThawRestridedException : public std::exception {
+  virtual const char* what() const throw()
+    {
+      return "A prefix tree expanded to several digits per level can't be thawed or written to a snapshot";
+    }
+};
+
 class TrieWrongRateTableException : public std::exception {
   virtual const char* what() const throw()
     {
@@ -58,24 +79,45 @@ class TrieCollisionDifferentRateException : public std::exception {
     }
 };
 
-class WorkerReleaseLeakException : public std::exception {
+class DBNoConnectionsException : public std::exception {
   virtual const char* what() const throw()
     {
-      return "Internal Error: Trying to release memory in the wrong worker thread";
+      return "At least one connection to the database is needed";
     }
 };
 
-class DBNoConnectionsException : public std::exception {
+class DBQueryFailedException : public std::exception {
   virtual const char* what() const throw()
     {
-      return "At least one connection to the database is needed";
+      return "Database queries are failing";
     }
 };
 
-class DBQueryFailedException : public std::exception {
+class DBCopyFailedException : public std::exception {
   virtual const char* what() const throw()
     {
-      return "Database queries are failing";
+      return "COPY of the rate rows from the database failed";
+    }
+};
+
+class DBCopyFormatException : public std::exception {
+  virtual const char* what() const throw()
+    {
+      return "Unexpected data in the binary COPY stream";
+    }
+};
+
+class SnapshotIOException : public std::exception {
+  virtual const char* what() const throw()
+    {
+      return "Can't read or write the snapshot file";
+    }
+};
+
+class SnapshotInvalidException : public std::exception {
+  virtual const char* what() const throw()
+    {
+      return "Snapshot file is corrupt, truncated or written by another version";
     }
 };
 
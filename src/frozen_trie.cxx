@@ -0,0 +1,368 @@
+#include "frozen_trie.hxx"
+#include "exceptions.hxx"
+
+using namespace trie;
+
+/**
+    Compacts the given prefix tree, copying its live rate records into a rate store
+*/
+FrozenTrie::FrozenTrie(const p_trie_t trie) : stride_trie(nullptr), jump_table(nullptr) {
+  rate_table_id = trie->get_rate_table_id();
+  rate_store = new RateStore(rate_table_id);
+  freeze_node(trie);
+  rate_store->shrink_to_fit();
+  nodes.shrink_to_fit();
+  child_offsets.shrink_to_fit();
+}
+
+/**
+    Reads back a prefix tree written by write_to, checking every offset points inside the arrays
+*/
+FrozenTrie::FrozenTrie(ctrl::SnapshotReader &reader, uint32_t code_names_count) : rate_store(nullptr), stride_trie(nullptr), jump_table(nullptr) {
+  rate_table_id = reader.read_value<uint32_t>();
+  reader.read_vector(nodes);
+  reader.read_vector(child_offsets);
+  rate_store = new RateStore(reader, code_names_count);
+  bool valid = !nodes.empty() && rate_store->get_rate_table_id() == rate_table_id;
+  for (auto node = nodes.begin(); valid && node != nodes.end(); ++node)
+    valid = node->children_bitmap < (1 << 10) &&
+            (size_t)node->children_pos + __builtin_popcount(node->children_bitmap) <= child_offsets.size() &&
+            (node->record == RateStore::NO_RECORD || node->record < rate_store->size());
+  for (auto child_offset = child_offsets.begin(); valid && child_offset != child_offsets.end(); ++child_offset)
+    valid = *child_offset < nodes.size();
+  if (!valid) {
+    delete rate_store;
+    throw SnapshotInvalidException();
+  }
+}
+
+FrozenTrie::~FrozenTrie() {
+  delete jump_table;
+  delete stride_trie;
+  delete rate_store;
+}
+
+/**
+    Replaces the one digit nodes by nodes consuming the given number of digits per level.
+    Node accessors are no longer usable afterwards, searches go through the multibit nodes.
+*/
+void FrozenTrie::restride(unsigned char stride) {
+  if (stride_trie || stride == 1)
+    return;
+  stride_trie = new StrideTrie(*this, stride);
+  delete jump_table;
+  jump_table = nullptr;
+  frozen_nodes_t().swap(nodes);
+  child_offsets_t().swap(child_offsets);
+}
+
+/**
+    Whether the one digit nodes were replaced by a StrideTrie
+*/
+bool FrozenTrie::is_restrided() const {
+  return stride_trie != nullptr;
+}
+
+/**
+    Appends the node and its descendants in DFS (pre-order) layout and returns the node offset
+*/
+uint32_t FrozenTrie::freeze_node(const p_trie_t trie) {
+  uint32_t node_offset = nodes.size();
+  frozen_node_t node = frozen_node_t();
+  node.children_bitmap = 0;
+  node.children_pos = child_offsets.size();
+  p_rate_record_t rate_record = trie->get_record();
+  node.record = rate_record ? rate_store->add_record(*rate_record) : RateStore::NO_RECORD;
+  unsigned char children_count = 0;
+  for (unsigned char i = 0; i < 10; ++i)
+    if (trie->has_child(i)) {
+      node.children_bitmap |= 1 << i;
+      children_count++;
+    }
+  nodes.push_back(node);
+  child_offsets.resize(child_offsets.size() + children_count);
+  uint32_t child_pos = node.children_pos;
+  for (unsigned char i = 0; i < 10; ++i)
+    if (trie->has_child(i)) {
+      uint32_t child_offset = freeze_node(trie->get_child(i));
+      child_offsets[child_pos++] = child_offset;
+    }
+  return node_offset;
+}
+
+/**
+    Adds a jump table over the given number of leading digits, only for tries with at least
+    as many nodes as the table has slots so small rate tables do not pay for it
+*/
+void FrozenTrie::add_jump_table(unsigned char jump_digits) {
+  if (jump_table || stride_trie || jump_digits == 0 || jump_digits > JumpTable::MAX_JUMP_DIGITS)
+    return;
+  size_t slots_count = 1;
+  for (unsigned char i = 0; i < jump_digits; ++i)
+    slots_count *= 10;
+  if (nodes.size() < slots_count)
+    return;
+  jump_table = new JumpTable(*this, jump_digits);
+}
+
+/**
+    Writes the one digit nodes and the rate store. The jump table and the multibit nodes are
+    rebuilt after reading, so the tree must not be restrided.
+*/
+void FrozenTrie::write_to(ctrl::SnapshotWriter &writer) const {
+  if (stride_trie)
+    throw TrieThawRestridedException();
+  writer.write_value<uint32_t>(rate_table_id);
+  writer.write_vector(nodes);
+  writer.write_vector(child_offsets);
+  rate_store->write_to(writer);
+}
+
+bool FrozenTrie::has_data(uint32_t node_offset) const {
+  return nodes[node_offset].record != RateStore::NO_RECORD;
+}
+
+bool FrozenTrie::has_children(uint32_t node_offset) const {
+  return nodes[node_offset].children_bitmap != 0;
+}
+
+uint32_t FrozenTrie::get_child(uint32_t node_offset, unsigned char index) const {
+  if (index > 9)
+    throw TrieInvalidChildIndexException();
+  const frozen_node_t &node = nodes[node_offset];
+  uint16_t mask = 1 << index;
+  if ((node.children_bitmap & mask) == 0)
+    return NO_NODE;
+  return child_offsets[node.children_pos + __builtin_popcount(node.children_bitmap & (mask - 1))];
+}
+
+unsigned int FrozenTrie::get_rate_table_id() const {
+  return rate_table_id;
+}
+
+size_t FrozenTrie::size() const {
+  if (stride_trie)
+    return stride_trie->size();
+  return nodes.size();
+}
+
+/**
+    Bytes taken by the prefix tree nodes (rate store excluded)
+*/
+size_t FrozenTrie::memory_usage() const {
+  size_t usage = sizeof(FrozenTrie) + nodes.capacity() * sizeof(frozen_node_t) + child_offsets.capacity() * sizeof(uint32_t);
+  if (stride_trie)
+    usage += stride_trie->memory_usage();
+  if (jump_table)
+    usage += jump_table->memory_usage();
+  return usage;
+}
+
+p_rate_store_t FrozenTrie::get_rate_store() const {
+  return rate_store;
+}
+
+uint32_t FrozenTrie::get_record(uint32_t node_offset) const {
+  return nodes[node_offset].record;
+}
+
+/**
+    Consumes the leading digits of the code through the jump table, if any, visiting the records
+    found along them. Returns the node the search continues from (NO_NODE if the path ended).
+*/
+uint32_t FrozenTrie::start_search(DigitCursor &digit_cursor, unsigned long long &current_code, PrefixMatch &match, rate_type_t rate_type, uint32_t filter_code_name_id) const {
+  current_code = 0;
+  if (!jump_table)
+    return 0;
+  uint32_t slot;
+  unsigned char leading_count = jump_table->read_slot(digit_cursor, slot);
+  if (leading_count == jump_table->get_jump_digits()) {
+    for (const jump_mark_t *mark = jump_table->marks_begin(slot); mark != jump_table->marks_end(slot); ++mark)
+      match.visit(rate_store, nodes[mark->node].record, jump_table->get_mark_code(slot, *mark), rate_type, filter_code_name_id);
+    current_code = slot;
+    return jump_table->get_node(slot);
+  }
+  uint32_t current_node = 0;
+  for (unsigned char i = 0; i < leading_count; ++i) {
+    unsigned char child_index = JumpTable::get_digit(slot, leading_count, i);
+    current_node = get_child(current_node, child_index);
+    if (current_node == NO_NODE)
+      break;
+    current_code = current_code * 10 + child_index;
+    uint32_t record = nodes[current_node].record;
+    if (record != RateStore::NO_RECORD)
+      match.visit(rate_store, record, current_code, rate_type, filter_code_name_id);
+  }
+  return current_node;
+}
+
+/**
+    Longest prefix search implementation, same semantics as Trie::search_code
+*/
+void FrozenTrie::search_code(unsigned long long code, rate_type_t rate_type, time_t reference_time, search::SearchResult &search_result, uint32_t filter_code_name_id, bool include_code) const {
+  if (stride_trie) {
+    stride_trie->search_code(code, rate_type, reference_time, search_result, filter_code_name_id, include_code);
+    return;
+  }
+  unsigned long long current_code;
+  PrefixMatch match;
+  DigitCursor digit_cursor(code);
+  uint32_t current_node = start_search(digit_cursor, current_code, match, rate_type, filter_code_name_id);
+  while (current_node != NO_NODE && digit_cursor.has_more_digits()) {
+    unsigned char child_index = digit_cursor.next_digit();
+    current_node = get_child(current_node, child_index);
+    if (current_node == NO_NODE)
+      break;
+    current_code = current_code * 10 + child_index;
+    uint32_t record = nodes[current_node].record;
+    if (record != RateStore::NO_RECORD)
+      match.visit(rate_store, record, current_code, rate_type, filter_code_name_id);
+  }
+  match.insert_into(search_result, rate_table_id, rate_type, reference_time, include_code);
+}
+
+/**
+    Longest prefix search of many codes, same semantics as calling search_code for each of them.
+    Up to SEARCH_LANES traversals advance in turns, each one prefetching its next node or child
+    offset before yielding, so the cache misses of one traversal overlap with the work of the others.
+    A lane whose traversal ends takes the next pending code.
+*/
+void FrozenTrie::search_codes(const unsigned long long *codes, size_t codes_count, rate_type_t rate_type, time_t reference_time, search::SearchResult &search_result, uint32_t filter_code_name_id, bool include_code) const {
+  search::SearchResult *search_results = &search_result;
+  search_codes_into(codes, codes_count, rate_type, reference_time, &search_results, 0, filter_code_name_id, include_code);
+}
+
+/**
+    Same as search_codes, inserting the matches of each code into the result of the same index
+*/
+void FrozenTrie::search_codes(const unsigned long long *codes, size_t codes_count, rate_type_t rate_type, time_t reference_time, search::SearchResult *const *search_results, uint32_t filter_code_name_id, bool include_code) const {
+  search_codes_into(codes, codes_count, rate_type, reference_time, search_results, 1, filter_code_name_id, include_code);
+}
+
+/**
+    The matches of the code of index i go into the result of index i * results_step
+*/
+void FrozenTrie::search_codes_into(const unsigned long long *codes, size_t codes_count, rate_type_t rate_type, time_t reference_time, search::SearchResult *const *search_results, size_t results_step, uint32_t filter_code_name_id, bool include_code) const {
+  if (stride_trie) {
+    for (size_t i = 0; i < codes_count; ++i)
+      stride_trie->search_code(codes[i], rate_type, reference_time, *search_results[i * results_step], filter_code_name_id, include_code);
+    return;
+  }
+  std::vector<SearchLane> lanes;
+  lanes.reserve(SEARCH_LANES);
+  size_t next_code = 0;
+  auto start_lane = [&](SearchLane &lane) {
+    lane.node_offset = start_search(lane.digit_cursor, lane.current_code, lane.match, rate_type, filter_code_name_id);
+    if (lane.node_offset != NO_NODE)
+      __builtin_prefetch(&nodes[lane.node_offset]);
+  };
+  while (next_code < codes_count && lanes.size() < SEARCH_LANES) {
+    lanes.push_back(SearchLane(codes[next_code], next_code));
+    ++next_code;
+    start_lane(lanes.back());
+  }
+  size_t active_lanes = lanes.size();
+  while (active_lanes > 0) {
+    for (size_t i = 0; i < active_lanes; ++i) {
+      SearchLane &lane = lanes[i];
+      bool lane_done = false;
+      if (lane.node_offset == NO_NODE)
+        lane_done = true;
+      else if (lane.reading_offset) {
+        lane.node_offset = child_offsets[lane.child_pos];
+        lane.current_code = lane.current_code * 10 + lane.child_index;
+        lane.reading_offset = false;
+        lane.visit_node = true;
+        __builtin_prefetch(&nodes[lane.node_offset]);
+      }
+      else {
+        const frozen_node_t &node = nodes[lane.node_offset];
+        if (lane.visit_node && node.record != RateStore::NO_RECORD)
+          lane.match.visit(rate_store, node.record, lane.current_code, rate_type, filter_code_name_id);
+        uint16_t mask = 0;
+        if (lane.digit_cursor.has_more_digits()) {
+          lane.child_index = lane.digit_cursor.next_digit();
+          mask = 1 << lane.child_index;
+        }
+        if ((node.children_bitmap & mask) == 0)
+          lane_done = true;
+        else {
+          lane.child_pos = node.children_pos + __builtin_popcount(node.children_bitmap & (mask - 1));
+          lane.reading_offset = true;
+          __builtin_prefetch(&child_offsets[lane.child_pos]);
+        }
+      }
+      if (!lane_done)
+        continue;
+      lane.match.insert_into(*search_results[lane.code_index * results_step], rate_table_id, rate_type, reference_time, include_code);
+      if (next_code < codes_count) {
+        lane = SearchLane(codes[next_code], next_code);
+        ++next_code;
+        start_lane(lane);
+      }
+      else {
+        lanes[i] = lanes[--active_lanes];
+        --i;
+      }
+    }
+  }
+}
+
+SearchLane::SearchLane(unsigned long long code, size_t code_index)
+  : digit_cursor(code),
+    node_offset(0),
+    child_pos(0),
+    current_code(0),
+    child_index(0),
+    reading_offset(false),
+    visit_node(false),
+    code_index(code_index) {}
+
+PrefixMatch::PrefixMatch()
+  : code_found(0),
+    code_name_id(ctrl::NO_CODE_NAME_ID),
+    current_min_rate(-1),
+    current_max_rate(-1),
+    future_min_rate(-1),
+    future_max_rate(-1) {}
+
+void PrefixMatch::visit(const p_rate_store_t rate_store, uint32_t record, unsigned long long code, rate_type_t rate_type, uint32_t filter_code_name_id) {
+  double data_current_rate = rate_store->get_current_rate(record, rate_type);
+  if (data_current_rate <= 0)
+    return;
+  if (current_min_rate <= 0 || data_current_rate < current_min_rate)
+    current_min_rate = data_current_rate;
+  code_name_id = rate_store->get_code_name_id(record);
+  if (filter_code_name_id != ctrl::NO_CODE_NAME_ID && code_name_id != filter_code_name_id)
+    return;
+  double data_future_rate = rate_store->get_future_rate(record, rate_type);
+  code_found = code;
+  current_max_rate = data_current_rate;
+  current_effective_date = rate_store->get_current_effective_date(record, rate_type);
+  current_end_date = rate_store->get_current_end_date(record, rate_type);
+  egress_trunk_id = rate_store->get_egress_trunk_id(record, rate_type);
+  if (future_min_rate <= 0 || data_future_rate < future_min_rate)
+    future_min_rate = data_future_rate;
+  future_max_rate = data_future_rate;
+  future_effective_date = rate_store->get_future_effective_date(record, rate_type);
+  future_end_date = rate_store->get_future_end_date(record, rate_type);
+}
+
+void PrefixMatch::insert_into(search::SearchResult &search_result, unsigned int rate_table_id, rate_type_t rate_type, time_t reference_time, bool include_code) const {
+  if (!code_found)
+    return;
+  search_result.insert(include_code ? code_found : 0,
+                       code_name_id,
+                       rate_table_id,
+                       rate_type,
+                       current_min_rate,
+                       current_max_rate,
+                       future_min_rate,
+                       future_max_rate,
+                       current_effective_date,
+                       current_end_date,
+                       future_effective_date,
+                       future_end_date,
+                       reference_time,
+                       egress_trunk_id);
+}
@@ -0,0 +1,115 @@
+/**
+      Read-only (frozen) prefix tree, compacted from a Trie once a load cycle is finished
+*/
+#ifndef FROZEN_TRIE_HXX
+#define FROZEN_TRIE_HXX
+
+#include "trie.hxx"
+#include "stride_trie.hxx"
+#include "jump_table.hxx"
+#include "digit_cursor.hxx"
+#include "rate_store.hxx"
+#include "search_result.hxx"
+#include "snapshot_file.hxx"
+#include "shared.hxx"
+#include <tbb/tbb.h>
+#include <vector>
+#include <cstdint>
+#include <time.h>
+
+namespace trie {
+
+  class FrozenTrie;
+  typedef FrozenTrie* p_frozen_trie_t;
+  typedef tbb::concurrent_vector<p_frozen_trie_t> frozen_tries_t;
+  typedef frozen_tries_t* p_frozen_tries_t;
+
+  /**
+      Accumulates the rate records matched along the path of a longest prefix search
+      in one rate table, and inserts the final match in the search result.
+  */
+  class PrefixMatch {
+    private:
+      unsigned long long code_found;
+      uint32_t code_name_id;
+      double current_min_rate;
+      double current_max_rate;
+      double future_min_rate;
+      double future_max_rate;
+      time_t current_effective_date;
+      time_t current_end_date;
+      time_t future_effective_date;
+      time_t future_end_date;
+      unsigned int egress_trunk_id;
+    public:
+      PrefixMatch();
+      void visit(const p_rate_store_t rate_store, uint32_t record, unsigned long long code, rate_type_t rate_type, uint32_t filter_code_name_id);
+      void insert_into(search::SearchResult &search_result, unsigned int rate_table_id, rate_type_t rate_type, time_t reference_time, bool include_code) const;
+  };
+
+  /**
+      State of one of the traversals interleaved by FrozenTrie::search_codes. A lane either has the
+      next node prefetched (reading the node) or the next child offset prefetched (reading the offset).
+  */
+  class SearchLane {
+    public:
+      DigitCursor digit_cursor;
+      uint32_t node_offset;
+      uint32_t child_pos;
+      unsigned long long current_code;
+      unsigned char child_index;
+      bool reading_offset;
+      bool visit_node;
+      size_t code_index;
+      PrefixMatch match;
+      SearchLane(unsigned long long code, size_t code_index);
+  };
+
+  /**
+      Node of a frozen prefix tree. Children offsets of a node are stored contiguously
+      in a separate array, starting at children_pos and indexed by the popcount of the
+      bitmap bits below the wanted digit.
+  */
+  typedef struct {
+    uint16_t children_bitmap;
+    uint32_t children_pos;
+    uint32_t record;
+  } frozen_node_t;
+
+  class FrozenTrie {
+    private:
+      typedef std::vector<frozen_node_t> frozen_nodes_t;
+      typedef std::vector<uint32_t> child_offsets_t;
+      unsigned int rate_table_id;
+      frozen_nodes_t nodes;
+      child_offsets_t child_offsets;
+      p_rate_store_t rate_store;
+      p_stride_trie_t stride_trie;
+      p_jump_table_t jump_table;
+      uint32_t freeze_node(const p_trie_t trie);
+      uint32_t start_search(DigitCursor &digit_cursor, unsigned long long &current_code, PrefixMatch &match, rate_type_t rate_type, uint32_t filter_code_name_id) const;
+      void search_codes_into(const unsigned long long *codes, size_t codes_count, rate_type_t rate_type, time_t reference_time, search::SearchResult *const *search_results, size_t results_step, uint32_t filter_code_name_id, bool include_code) const;
+    public:
+      static const unsigned char SEARCH_LANES = 8;
+      static const uint32_t NO_NODE = UINT32_MAX;
+      FrozenTrie(const p_trie_t trie);
+      FrozenTrie(ctrl::SnapshotReader &reader, uint32_t code_names_count);
+      ~FrozenTrie();
+      unsigned int get_rate_table_id() const;
+      p_rate_store_t get_rate_store() const;
+      size_t size() const;
+      size_t memory_usage() const;
+      void restride(unsigned char stride);
+      bool is_restrided() const;
+      void add_jump_table(unsigned char jump_digits);
+      void write_to(ctrl::SnapshotWriter &writer) const;
+      bool has_children(uint32_t node_offset) const;
+      bool has_data(uint32_t node_offset) const;
+      uint32_t get_child(uint32_t node_offset, unsigned char index) const;
+      uint32_t get_record(uint32_t node_offset) const;
+      void search_code(unsigned long long code, rate_type_t rate_type, time_t reference_time, search::SearchResult &search_result, uint32_t filter_code_name_id = ctrl::NO_CODE_NAME_ID, bool include_code = false) const;
+      void search_codes(const unsigned long long *codes, size_t codes_count, rate_type_t rate_type, time_t reference_time, search::SearchResult &search_result, uint32_t filter_code_name_id = ctrl::NO_CODE_NAME_ID, bool include_code = false) const;
+      void search_codes(const unsigned long long *codes, size_t codes_count, rate_type_t rate_type, time_t reference_time, search::SearchResult *const *search_results, uint32_t filter_code_name_id = ctrl::NO_CODE_NAME_ID, bool include_code = false) const;
+  };
+}
+#endif
@@ -0,0 +1,139 @@
+#include "generation.hxx"
+#include <thread>
+
+using namespace ctrl;
+
+/** Ids start from the startup time, so cursors of a previous run don't match */
+std::atomic<unsigned long long> Generation::last_id((unsigned long long)time(nullptr) << 16);
+
+Generation::Generation(time_t reference_time)
+  : id(++last_id),
+    reference_time(reference_time),
+    world_tables_tries(nullptr),
+    world_tables_index(nullptr),
+    world_unified_index(nullptr),
+    us_tables_tries(nullptr),
+    us_tables_index(nullptr),
+    us_unified_index(nullptr),
+    az_tables_tries(nullptr),
+    az_tables_index(nullptr),
+    az_unified_index(nullptr),
+    codes(nullptr),
+    code_names(nullptr),
+    code_name_results(nullptr),
+    codes_arenas(nullptr),
+    codes_handed_over(false) {}
+
+Generation::~Generation() {
+  delete world_unified_index;
+  delete us_unified_index;
+  delete az_unified_index;
+  for (p_frozen_tables_t frozen_tables : {world_tables_tries, us_tables_tries, az_tables_tries}) {
+    if (!frozen_tables)
+      continue;
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, frozen_tables->size()),
+      [&](const tbb::blocked_range<size_t> &r) {
+        for (size_t i = r.begin(); i != r.end(); ++i)
+          if (handed_over_tables.find((*frozen_tables)[i]) == handed_over_tables.end())
+            delete (*frozen_tables)[i];
+      });
+    delete frozen_tables;
+  }
+  delete world_tables_index;
+  delete us_tables_index;
+  delete az_tables_index;
+  delete code_names;
+  delete code_name_results;
+  if (codes_handed_over)
+    return;
+  delete codes;
+  if (codes_arenas) {
+    for (size_t i = 0; i < codes_arenas->size(); ++i)
+      delete (*codes_arenas)[i];
+    delete codes_arenas;
+  }
+}
+
+/**
+    Returns the frozen tree of the given rate table in the given partition, if any
+*/
+trie::p_frozen_trie_t Generation::find_table(unsigned char partition, unsigned int rate_table_id) const {
+  p_frozen_tables_t frozen_tables = partition == 0 ? world_tables_tries : (partition == 1 ? us_tables_tries : az_tables_tries);
+  p_tables_index_t tables_index = partition == 0 ? world_tables_index : (partition == 1 ? us_tables_index : az_tables_index);
+  tables_index_t::const_iterator it = tables_index->find(rate_table_id);
+  if (it == tables_index->end())
+    return nullptr;
+  return (*frozen_tables)[it->second];
+}
+
+std::atomic<PublishedGeneration::p_reader_slot_t> PublishedGeneration::reader_slots(nullptr);
+
+/**
+    Claims a slot left by a finished thread, or adds a new one. Slots are never freed.
+*/
+PublishedGeneration::ReaderSlotOwner::ReaderSlotOwner() {
+  for (reader_slot = reader_slots.load(std::memory_order_acquire); reader_slot; reader_slot = reader_slot->next) {
+    bool in_use = false;
+    if (reader_slot->in_use.compare_exchange_strong(in_use, true))
+      return;
+  }
+  reader_slot = new reader_slot_t();
+  reader_slot->generation.store(nullptr);
+  reader_slot->in_use.store(true);
+  reader_slot->pins_count = 0;
+  reader_slot->next = reader_slots.load(std::memory_order_acquire);
+  while (!reader_slots.compare_exchange_weak(reader_slot->next, reader_slot, std::memory_order_acq_rel));
+}
+
+PublishedGeneration::ReaderSlotOwner::~ReaderSlotOwner() {
+  reader_slot->generation.store(nullptr);
+  reader_slot->in_use.store(false, std::memory_order_release);
+}
+
+PublishedGeneration::p_reader_slot_t PublishedGeneration::get_reader_slot() {
+  static thread_local ReaderSlotOwner reader_slot_owner;
+  return reader_slot_owner.reader_slot;
+}
+
+PublishedGeneration::PublishedGeneration() : current(nullptr) {}
+
+/**
+    Publishes the given generation and returns the previous one once no reader holds it anymore
+*/
+p_generation_t PublishedGeneration::replace(p_generation_t generation) {
+  p_generation_t replaced = current.exchange(generation);
+  if (!replaced)
+    return nullptr;
+  for (p_reader_slot_t reader_slot = reader_slots.load(); reader_slot; reader_slot = reader_slot->next)
+    while (reader_slot->generation.load() == replaced)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  return replaced;
+}
+
+/**
+    Announces the current generation, then checks it is still current: otherwise the writer may
+    have missed the announcement, so it retries with the newer one
+*/
+GenerationPin::GenerationPin(PublishedGeneration &published_generation) : reader_slot(PublishedGeneration::get_reader_slot()) {
+  if (reader_slot->pins_count++ > 0) {
+    generation = reader_slot->generation.load(std::memory_order_relaxed);
+    return;
+  }
+  generation = published_generation.current.load();
+  while (true) {
+    reader_slot->generation.store(generation);
+    p_generation_t current = published_generation.current.load();
+    if (current == generation)
+      break;
+    generation = current;
+  }
+}
+
+GenerationPin::~GenerationPin() {
+  if (--reader_slot->pins_count == 0)
+    reader_slot->generation.store(nullptr, std::memory_order_release);
+}
+
+p_generation_t GenerationPin::get() const {
+  return generation;
+}
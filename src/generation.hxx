@@ -0,0 +1,111 @@
+/**
+      Read-only rate tables of one load, published to the readers as a whole
+*/
+#ifndef GENERATION_HXX
+#define GENERATION_HXX
+
+#include "frozen_trie.hxx"
+#include "unified_index.hxx"
+#include "code_names.hxx"
+#include "code_name_results.hxx"
+#include "arena.hxx"
+#include "shared.hxx"
+#include <tbb/tbb.h>
+#include <atomic>
+#include <string>
+#include <set>
+#include <time.h>
+
+namespace ctrl {
+
+  class Generation;
+  class PublishedGeneration;
+  class GenerationPin;
+  typedef Generation* p_generation_t;
+
+  typedef tbb::concurrent_unordered_map<unsigned int, size_t> tables_index_t;
+  typedef trie::frozen_tries_t frozen_tables_t;
+  typedef tables_index_t* p_tables_index_t;
+  typedef frozen_tables_t* p_frozen_tables_t;
+  typedef tbb::concurrent_unordered_map<std::string, p_code_value_t> codes_t;
+  typedef codes_t* p_codes_t;
+  typedef tbb::concurrent_vector<p_arena_t> arenas_t;
+  typedef arenas_t* p_arenas_t;
+
+  /**
+      Never modified once published. Deleting it releases its tables, code names ids, codes and
+      code arenas, except the ones handed over to the next generation by a delta load.
+      Ids tell the generations apart in the cursors of paginated searches.
+      Partitions are numbered 0 (world), 1 (us) and 2 (az).
+  */
+  class Generation {
+    private:
+      static std::atomic<unsigned long long> last_id;
+    public:
+      unsigned long long id;
+      time_t reference_time;
+      p_frozen_tables_t world_tables_tries;
+      p_tables_index_t world_tables_index;
+      trie::p_unified_index_t world_unified_index;
+      p_frozen_tables_t us_tables_tries;
+      p_tables_index_t us_tables_index;
+      trie::p_unified_index_t us_unified_index;
+      p_frozen_tables_t az_tables_tries;
+      p_tables_index_t az_tables_index;
+      trie::p_unified_index_t az_unified_index;
+      p_codes_t codes;
+      p_code_names_t code_names;
+      p_code_name_results_t code_name_results;
+      p_arenas_t codes_arenas;
+      std::set<trie::p_frozen_trie_t> handed_over_tables;
+      bool codes_handed_over;
+      Generation(time_t reference_time);
+      ~Generation();
+      trie::p_frozen_trie_t find_table(unsigned char partition, unsigned int rate_table_id) const;
+  };
+
+  /**
+      Current generation, swapped with a single atomic store. Readers pin the generation they use
+      by announcing it in a slot of their own thread (a hazard pointer), so pinning takes no lock
+      and writes no shared cache line. A replaced generation is handed back once no slot holds it.
+  */
+  class PublishedGeneration {
+    friend class GenerationPin;
+    private:
+      typedef struct reader_slot_t {
+        std::atomic<p_generation_t> generation;
+        std::atomic_bool in_use;
+        unsigned int pins_count;
+        reader_slot_t *next;
+        char padding[64];
+      } reader_slot_t;
+      typedef reader_slot_t* p_reader_slot_t;
+      class ReaderSlotOwner {
+        public:
+          p_reader_slot_t reader_slot;
+          ReaderSlotOwner();
+          ~ReaderSlotOwner();
+      };
+      static std::atomic<p_reader_slot_t> reader_slots;
+      static p_reader_slot_t get_reader_slot();
+      std::atomic<p_generation_t> current;
+    public:
+      PublishedGeneration();
+      p_generation_t replace(p_generation_t generation);
+  };
+
+  /**
+      Keeps the current generation alive while in scope. Pins nest: an inner pin of the same
+      thread keeps using the generation of the outer one.
+  */
+  class GenerationPin {
+    private:
+      PublishedGeneration::p_reader_slot_t reader_slot;
+      p_generation_t generation;
+    public:
+      GenerationPin(PublishedGeneration &published_generation);
+      ~GenerationPin();
+      p_generation_t get() const;
+  };
+}
+#endif
@@ -0,0 +1,58 @@
+#include "jump_table.hxx"
+
+using namespace trie;
+
+uint32_t JumpTable::power10(unsigned char exponent) {
+  uint32_t power = 1;
+  for (unsigned char i = 0; i < exponent; ++i)
+    power *= 10;
+  return power;
+}
+
+unsigned char JumpTable::get_jump_digits() const {
+  return jump_digits;
+}
+
+/**
+    Consumes up to jump_digits leading digits of the code, returns how many were read.
+    The slot only applies when all of them were read; shorter codes must walk the digits read.
+*/
+unsigned char JumpTable::read_slot(DigitCursor &digit_cursor, uint32_t &slot) const {
+  unsigned char digits_count = 0;
+  slot = 0;
+  while (digits_count < jump_digits && digit_cursor.has_more_digits()) {
+    slot = slot * 10 + digit_cursor.next_digit();
+    digits_count++;
+  }
+  return digits_count;
+}
+
+/**
+    Digit at the given position (from the left) of a slot holding digits_count digits
+*/
+unsigned char JumpTable::get_digit(uint32_t slot, unsigned char digits_count, unsigned char position) {
+  return (slot / power10(digits_count - position - 1)) % 10;
+}
+
+uint32_t JumpTable::get_node(uint32_t slot) const {
+  return slots[slot].node;
+}
+
+const jump_mark_t* JumpTable::marks_begin(uint32_t slot) const {
+  return marks.data() + slots[slot].marks_pos;
+}
+
+const jump_mark_t* JumpTable::marks_end(uint32_t slot) const {
+  return marks.data() + slots[slot + 1].marks_pos;
+}
+
+/**
+    Prefix code of the node marked at the given depth of the slot path
+*/
+uint32_t JumpTable::get_mark_code(uint32_t slot, const jump_mark_t &mark) const {
+  return slot / power10(jump_digits - mark.depth);
+}
+
+size_t JumpTable::memory_usage() const {
+  return sizeof(JumpTable) + slots.capacity() * sizeof(jump_slot_t) + marks.capacity() * sizeof(jump_mark_t);
+}
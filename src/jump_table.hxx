@@ -0,0 +1,76 @@
+/**
+      Directly indexed table of the leading digits of a prefix tree, skipping its top levels on every search
+*/
+#ifndef JUMP_TABLE_HXX
+#define JUMP_TABLE_HXX
+
+#include "digit_cursor.hxx"
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace trie {
+
+  class JumpTable;
+  typedef JumpTable* p_jump_table_t;
+
+  /**
+      One slot per combination of the leading digits: the node reached after walking them (NO_NODE
+      when the path ends earlier) and the nodes with data found along that path (the marks).
+      Marks of a slot end where the marks of the next slot start.
+  */
+  typedef struct {
+    uint32_t node;
+    uint32_t marks_pos;
+  } jump_slot_t;
+
+  typedef struct {
+    uint32_t node;
+    uint32_t depth;
+  } jump_mark_t;
+
+  class JumpTable {
+    private:
+      typedef std::vector<jump_slot_t> jump_slots_t;
+      typedef std::vector<jump_mark_t> jump_marks_t;
+      unsigned char jump_digits;
+      jump_slots_t slots;
+      jump_marks_t marks;
+      static uint32_t power10(unsigned char exponent);
+    public:
+      static const unsigned char MAX_JUMP_DIGITS = 6;
+      static const uint32_t NO_NODE = UINT32_MAX;
+      template <typename index_t> JumpTable(const index_t &index, unsigned char jump_digits);
+      unsigned char get_jump_digits() const;
+      unsigned char read_slot(DigitCursor &digit_cursor, uint32_t &slot) const;
+      static unsigned char get_digit(uint32_t slot, unsigned char digits_count, unsigned char position);
+      uint32_t get_node(uint32_t slot) const;
+      const jump_mark_t* marks_begin(uint32_t slot) const;
+      const jump_mark_t* marks_end(uint32_t slot) const;
+      uint32_t get_mark_code(uint32_t slot, const jump_mark_t &mark) const;
+      size_t memory_usage() const;
+  };
+
+  /**
+      Walks every combination of jump_digits leading digits in the given index, which must provide
+      get_child(node, digit) and has_data(node) with NO_NODE for missing children.
+  */
+  template <typename index_t> JumpTable::JumpTable(const index_t &index, unsigned char jump_digits) : jump_digits(jump_digits) {
+    uint32_t slots_count = power10(jump_digits);
+    slots.resize(slots_count + 1);
+    for (uint32_t slot = 0; slot < slots_count; ++slot) {
+      slots[slot].marks_pos = marks.size();
+      uint32_t current_node = 0;
+      for (unsigned char depth = 1; depth <= jump_digits && current_node != NO_NODE; ++depth) {
+        current_node = index.get_child(current_node, get_digit(slot, jump_digits, depth - 1));
+        if (current_node != NO_NODE && index.has_data(current_node))
+          marks.push_back({current_node, depth});
+      }
+      slots[slot].node = current_node;
+    }
+    slots[slots_count].node = NO_NODE;    // Sentinel marking the end of the marks of the last slot
+    slots[slots_count].marks_pos = marks.size();
+    marks.shrink_to_fit();
+  }
+}
+#endif
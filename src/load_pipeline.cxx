@@ -0,0 +1,126 @@
+#include "load_pipeline.hxx"
+#include "controller.hxx"
+#include "logger.hxx"
+
+using namespace ctrl;
+
+/**
+    Rows are inserted through the arenas (and the load shards) of connection partition % conn_count,
+    so with load shards there must be as many partitions as connections
+*/
+LoadPipeline::LoadPipeline(db::p_db_t database, unsigned int conn_count, unsigned int partitions_count)
+  : database(database),
+    conn_count(conn_count),
+    partitions_count(partitions_count),
+    rows_count(0),
+    ranges(graph, [this](p_chunk_t &chunk) { return next_chunk(chunk); }, false),
+    chunks_limiter(graph, conn_count * CHUNKS_IN_FLIGHT_PER_CONNECTION),
+    fetch(graph, conn_count, [this](p_chunk_t chunk) { return fetch_chunk(chunk); }),
+    parse(graph, tbb::flow::unlimited, [this](p_chunk_t chunk) { parse_chunk(chunk); return tbb::flow::continue_msg(); })
+{
+  for (unsigned int i = 0; i < conn_count; ++i)
+    free_connections.push(i);
+  for (unsigned int i = 0; i < partitions_count; ++i)
+    inserts.push_back(new insert_node_t(graph, tbb::flow::serial,
+      [this](p_partition_rows_t partition_rows) { insert_rows(partition_rows); return tbb::flow::continue_msg(); }));
+  tbb::flow::make_edge(ranges, chunks_limiter);
+  tbb::flow::make_edge(chunks_limiter, fetch);
+  tbb::flow::make_edge(fetch, parse);
+}
+
+LoadPipeline::~LoadPipeline() {
+  for (size_t i = 0; i < inserts.size(); ++i)
+    delete inserts[i];
+}
+
+/**
+    Runs the graph until every range is read and inserted, returns the number of rows inserted
+*/
+unsigned long long LoadPipeline::run() {
+  log("Loading through " + std::to_string(conn_count) + " fetching connections and " + std::to_string(partitions_count) + " insertion partitions...");
+  ranges.activate();
+  graph.wait_for_all();
+  return rows_count;
+}
+
+bool LoadPipeline::next_chunk(p_chunk_t &chunk) {
+  unsigned int first_rate_id;
+  unsigned int last_rate_id;
+  if (!database->next_range(first_rate_id, last_rate_id))
+    return false;
+  chunk = new chunk_t();
+  chunk->batch.first_rate_id = first_rate_id;
+  chunk->batch.last_rate_id = last_rate_id;
+  return true;
+}
+
+/**
+    Queries the range through a free connection: there are as many concurrent fetches as connections
+*/
+LoadPipeline::p_chunk_t LoadPipeline::fetch_chunk(p_chunk_t chunk) {
+  free_connections.pop(chunk->batch.conn_index);
+  log("Reading records through connection: " + std::to_string(chunk->batch.conn_index) + ", from rate_id: " + std::to_string(chunk->batch.first_rate_id) +
+      " to rate_id: " + std::to_string(chunk->batch.last_rate_id));
+  try {
+    database->fetch_batch(chunk->batch);
+  }
+  catch (...) {
+    free_connections.push(chunk->batch.conn_index);
+    throw;
+  }
+  free_connections.push(chunk->batch.conn_index);
+  return chunk;
+}
+
+/**
+    Parses the fetched rows and hands them to the insertion node of their rate table
+*/
+void LoadPipeline::parse_chunk(p_chunk_t chunk) {
+  database->parse_batch(chunk->batch);
+  std::vector<p_partition_rows_t> partitions(partitions_count, nullptr);
+  for (size_t i = 0; i < chunk->batch.rows.size(); ++i) {
+    db::db_data_t &db_data = chunk->batch.rows[i];
+    unsigned int partition = db_data.rate_table_id % partitions_count;
+    if (!partitions[partition]) {
+      partitions[partition] = new partition_rows_t();
+      partitions[partition]->chunk = chunk;
+      partitions[partition]->partition = partition;
+    }
+    partitions[partition]->rows.push_back(std::move(db_data));
+  }
+  db::db_rows_t().swap(chunk->batch.rows);
+  unsigned int pending_partitions = 0;
+  for (unsigned int i = 0; i < partitions_count; ++i)
+    if (partitions[i])
+      pending_partitions++;
+  chunk->pending_partitions = pending_partitions;
+  if (pending_partitions == 0) {
+    finish_chunk(chunk);
+    return;
+  }
+  for (unsigned int i = 0; i < partitions_count; ++i)
+    if (partitions[i])
+      inserts[i]->try_put(partitions[i]);
+}
+
+void LoadPipeline::insert_rows(p_partition_rows_t partition_rows) {
+  p_controller_t controller = Controller::get_controller();
+  unsigned int conn_index = partition_rows->partition % conn_count;
+  for (size_t i = 0; i < partition_rows->rows.size(); ++i) {
+    partition_rows->rows[i].conn_index = conn_index;
+    controller->insert_new_rate_data(std::move(partition_rows->rows[i]));
+  }
+  rows_count += partition_rows->rows.size();
+  p_chunk_t chunk = partition_rows->chunk;
+  delete partition_rows;
+  if (--chunk->pending_partitions == 0)
+    finish_chunk(chunk);
+}
+
+/**
+    Lets the next range in once every row of the chunk is inserted
+*/
+void LoadPipeline::finish_chunk(p_chunk_t chunk) {
+  delete chunk;
+  chunks_limiter.decrement.try_put(tbb::flow::continue_msg());
+}
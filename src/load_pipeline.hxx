@@ -0,0 +1,61 @@
+/**
+      Load cycle run as a flow graph: fetching, parsing and inserting rate rows overlap
+*/
+#ifndef LOAD_PIPELINE_HXX
+#define LOAD_PIPELINE_HXX
+
+#include "db.hxx"
+#include <tbb/tbb.h>
+#include <tbb/flow_graph.h>
+#include <atomic>
+#include <vector>
+
+namespace ctrl {
+
+  class LoadPipeline;
+  typedef LoadPipeline* p_load_pipeline_t;
+
+  /**
+      Ranges of rate_ids go through a fetch node (one query per connection at a time), then a
+      parse node running on as many cores as available, which splits the rows by rate table
+      among serial insertion nodes, so a rate table is only inserted into by one node at a time.
+      A limiter bounds the ranges in flight between fetching and the end of their insertion.
+  */
+  class LoadPipeline {
+    private:
+      typedef struct {
+        db::db_batch_t batch;
+        std::atomic<unsigned int> pending_partitions;
+      } chunk_t;
+      typedef chunk_t* p_chunk_t;
+      typedef struct {
+        p_chunk_t chunk;
+        unsigned int partition;
+        db::db_rows_t rows;
+      } partition_rows_t;
+      typedef partition_rows_t* p_partition_rows_t;
+      typedef tbb::flow::function_node<p_partition_rows_t> insert_node_t;
+      db::p_db_t database;
+      unsigned int conn_count;
+      unsigned int partitions_count;
+      std::atomic<unsigned long long> rows_count;
+      tbb::concurrent_bounded_queue<unsigned int> free_connections;
+      tbb::flow::graph graph;
+      tbb::flow::source_node<p_chunk_t> ranges;
+      tbb::flow::limiter_node<p_chunk_t> chunks_limiter;
+      tbb::flow::function_node<p_chunk_t, p_chunk_t> fetch;
+      tbb::flow::function_node<p_chunk_t> parse;
+      std::vector<insert_node_t*> inserts;
+      bool next_chunk(p_chunk_t &chunk);
+      p_chunk_t fetch_chunk(p_chunk_t chunk);
+      void parse_chunk(p_chunk_t chunk);
+      void insert_rows(p_partition_rows_t partition_rows);
+      void finish_chunk(p_chunk_t chunk);
+    public:
+      static const unsigned int CHUNKS_IN_FLIGHT_PER_CONNECTION = 2;
+      LoadPipeline(db::p_db_t database, unsigned int conn_count, unsigned int partitions_count);
+      ~LoadPipeline();
+      unsigned long long run();
+  };
+}
+#endif
@@ -0,0 +1,78 @@
+#include "load_shard.hxx"
+#include <algorithm>
+
+using namespace ctrl;
+
+LoadShard::LoadShard(unsigned int worker_index) : worker_index(worker_index) {}
+
+unsigned int LoadShard::get_worker_index() const {
+  return worker_index;
+}
+
+size_t LoadShard::size() const {
+  return rows.size();
+}
+
+/**
+    Appends a row (code name already in upper case) of the given partition
+*/
+void LoadShard::add_row(const db::db_data_t &db_data, unsigned char partition) {
+  code_names_index_t::iterator it = code_names_index.find(db_data.code_name);
+  if (it == code_names_index.end()) {
+    it = code_names_index.insert(std::make_pair(db_data.code_name, (uint32_t)code_names.size())).first;
+    code_names.push_back(db_data.code_name);
+  }
+  shard_row_t row;
+  row.code = db_data.code;
+  row.rate_table_id = db_data.rate_table_id;
+  row.code_name_index = it->second;
+  row.partition = partition;
+  row.rates[trie::RATE_TYPE_DEFAULT] = db_data.default_rate;
+  row.rates[trie::RATE_TYPE_INTER] = db_data.inter_rate;
+  row.rates[trie::RATE_TYPE_INTRA] = db_data.intra_rate;
+  row.rates[trie::RATE_TYPE_LOCAL] = db_data.local_rate;
+  row.effective_date = db_data.effective_date;
+  row.end_date = db_data.end_date;
+  row.egress_trunk_id = db_data.egress_trunk_id;
+  rows.push_back(row);
+}
+
+/**
+    Groups the rows by partition and rate table, keeping the reading order within each group,
+    and returns the groups
+*/
+shard_runs_t LoadShard::sort_runs() {
+  std::stable_sort(rows.begin(), rows.end(),
+    [](const shard_row_t &a, const shard_row_t &b) {
+      return a.partition < b.partition || (a.partition == b.partition && a.rate_table_id < b.rate_table_id);
+    });
+  shard_runs_t runs;
+  for (size_t i = 0; i < rows.size(); ++i) {
+    if (runs.empty() || runs.back().partition != rows[i].partition || runs.back().rate_table_id != rows[i].rate_table_id) {
+      shard_run_t run;
+      run.partition = rows[i].partition;
+      run.rate_table_id = rows[i].rate_table_id;
+      run.begin = i;
+      runs.push_back(run);
+    }
+    runs.back().end = i + 1;
+  }
+  return runs;
+}
+
+const shard_row_t &LoadShard::get_row(size_t index) const {
+  return rows[index];
+}
+
+const std::vector<std::string> &LoadShard::get_code_names() const {
+  return code_names;
+}
+
+/**
+    Drops the rows and code names, releasing their memory
+*/
+void LoadShard::clear() {
+  std::vector<shard_row_t>().swap(rows);
+  std::vector<std::string>().swap(code_names);
+  code_names_index_t().swap(code_names_index);
+}
@@ -0,0 +1,63 @@
+/**
+      Rate rows read by one database connection during a load, kept private to its worker
+*/
+#ifndef LOAD_SHARD_HXX
+#define LOAD_SHARD_HXX
+
+#include "db.hxx"
+#include "shared.hxx"
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+#include <time.h>
+
+namespace ctrl {
+
+  class LoadShard;
+  typedef LoadShard* p_load_shard_t;
+
+  /** A rate row, with its code name replaced by its position in the shard code names */
+  typedef struct {
+    unsigned long long code;
+    unsigned int rate_table_id;
+    uint32_t code_name_index;
+    unsigned char partition;
+    double rates[trie::RATE_TYPES_COUNT];
+    time_t effective_date;
+    time_t end_date;
+    unsigned int egress_trunk_id;
+  } shard_row_t;
+
+  /** Consecutive rows of the same rate table and partition, once the rows are sorted */
+  typedef struct {
+    unsigned char partition;
+    unsigned int rate_table_id;
+    size_t begin;
+    size_t end;
+  } shard_run_t;
+  typedef std::vector<shard_run_t> shard_runs_t;
+
+  /**
+      Only the owning worker appends rows, so no synchronisation is needed while loading. Rows
+      are merged into the shared tables by the controller once every connection is done reading.
+  */
+  class LoadShard {
+    private:
+      typedef std::unordered_map<std::string, uint32_t> code_names_index_t;
+      unsigned int worker_index;
+      std::vector<shard_row_t> rows;
+      std::vector<std::string> code_names;
+      code_names_index_t code_names_index;
+    public:
+      LoadShard(unsigned int worker_index);
+      unsigned int get_worker_index() const;
+      size_t size() const;
+      void add_row(const db::db_data_t &db_data, unsigned char partition);
+      shard_runs_t sort_runs();
+      const shard_row_t &get_row(size_t index) const;
+      const std::vector<std::string> &get_code_names() const;
+      void clear();
+  };
+}
+#endif
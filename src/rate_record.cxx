@@ -0,0 +1,85 @@
+#include "rate_record.hxx"
+#include <cstring>
+
+using namespace trie;
+
+RateRecord::RateRecord() : code_item(nullptr) {
+  memset(fields, 0, sizeof(fields));
+}
+
+/**
+    Copies the rate fields of the given record, or clears them if there is none
+*/
+void RateRecord::copy_from(const p_rate_record_t rate_record) {
+  if (rate_record) {
+    memcpy(fields, rate_record->fields, sizeof(fields));
+    code_item = rate_record->code_item;
+  }
+  else {
+    memset(fields, 0, sizeof(fields));
+    code_item = nullptr;
+  }
+}
+
+/**
+    Applies a rate row: keeps the latest current rate and the earliest future rate
+*/
+void RateRecord::update(rate_type_t rate_type, double rate, time_t reference_time, time_t effective_date, time_t end_date, ctrl::p_code_pair_t code_item, unsigned int egress_trunk_id) {
+  rate_fields_t &rate_fields = fields[rate_type];
+  if ( effective_date <= reference_time && effective_date > get_current_effective_date(rate_type) &&
+      (end_date <= 0 || end_date >= reference_time)) {
+        if (rate > 0)
+          rate_fields.current_rate = RateStore::to_fixed_rate(rate);
+        if (effective_date > 0)
+          rate_fields.current_effective_date = RateStore::to_compact_date(effective_date);
+        if (end_date > 0)
+          rate_fields.current_end_date = RateStore::to_compact_date(end_date);
+        this->code_item = code_item;
+        rate_fields.egress_trunk_id = egress_trunk_id;
+  }
+  if (effective_date > reference_time && (get_future_rate(rate_type) == -1 || effective_date < get_future_effective_date(rate_type))) {
+    if (rate > 0)
+      rate_fields.future_rate = RateStore::to_fixed_rate(rate);
+    if (effective_date > 0)
+      rate_fields.future_effective_date = RateStore::to_compact_date(effective_date);
+    if (end_date > 0)
+      rate_fields.future_end_date = RateStore::to_compact_date(end_date);
+    if (get_current_end_date(rate_type) >= effective_date && effective_date - 1 > 0)
+      rate_fields.current_end_date = RateStore::to_compact_date(effective_date - 1);
+  }
+}
+
+double RateRecord::get_current_rate(rate_type_t rate_type) const {
+  return RateStore::from_fixed_rate(fields[rate_type].current_rate);
+}
+
+time_t RateRecord::get_current_effective_date(rate_type_t rate_type) const {
+  return RateStore::from_compact_date(fields[rate_type].current_effective_date);
+}
+
+time_t RateRecord::get_current_end_date(rate_type_t rate_type) const {
+  return RateStore::from_compact_date(fields[rate_type].current_end_date);
+}
+
+double RateRecord::get_future_rate(rate_type_t rate_type) const {
+  return RateStore::from_fixed_rate(fields[rate_type].future_rate);
+}
+
+time_t RateRecord::get_future_effective_date(rate_type_t rate_type) const {
+  return RateStore::from_compact_date(fields[rate_type].future_effective_date);
+}
+
+time_t RateRecord::get_future_end_date(rate_type_t rate_type) const {
+  return RateStore::from_compact_date(fields[rate_type].future_end_date);
+}
+
+unsigned int RateRecord::get_egress_trunk_id(rate_type_t rate_type) const {
+  return fields[rate_type].egress_trunk_id;
+}
+
+uint32_t RateRecord::get_code_name_id() const {
+  if (code_item)
+    return code_item->second->code_name_id.load(std::memory_order_acquire);
+  else
+    return ctrl::NO_CODE_NAME_ID;
+}
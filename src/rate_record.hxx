@@ -0,0 +1,51 @@
+/**
+      Rate record of a code while a rate table is being loaded
+*/
+#ifndef RATE_RECORD_HXX
+#define RATE_RECORD_HXX
+
+#include "rate_store.hxx"
+#include "shared.hxx"
+#include <cstdint>
+#include <time.h>
+
+namespace trie {
+
+  class RateRecord;
+  typedef RateRecord* p_rate_record_t;
+
+  /**
+      Published records are never modified: an update copies the current record, applies the new
+      row and swaps the copy in. Records live in the loading arena, so a replaced record (which
+      another loader may still be reading) stays valid until the arena is cleared.
+      Fields use the RateStore encoding, where zero means "no value".
+  */
+  class RateRecord {
+    friend class RateStore;
+    private:
+      typedef struct {
+        fixed_rate_t current_rate;
+        compact_date_t current_effective_date;
+        compact_date_t current_end_date;
+        fixed_rate_t future_rate;
+        compact_date_t future_effective_date;
+        compact_date_t future_end_date;
+        uint32_t egress_trunk_id;
+      } rate_fields_t;
+      rate_fields_t fields[RATE_TYPES_COUNT];
+      ctrl::p_code_pair_t code_item;
+    public:
+      RateRecord();
+      void copy_from(const p_rate_record_t rate_record);
+      void update(rate_type_t rate_type, double rate, time_t reference_time, time_t effective_date, time_t end_date, ctrl::p_code_pair_t code_item, unsigned int egress_trunk_id);
+      double get_current_rate(rate_type_t rate_type) const;
+      time_t get_current_effective_date(rate_type_t rate_type) const;
+      time_t get_current_end_date(rate_type_t rate_type) const;
+      double get_future_rate(rate_type_t rate_type) const;
+      time_t get_future_effective_date(rate_type_t rate_type) const;
+      time_t get_future_end_date(rate_type_t rate_type) const;
+      unsigned int get_egress_trunk_id(rate_type_t rate_type) const;
+      uint32_t get_code_name_id() const;
+  };
+}
+#endif
@@ -0,0 +1,192 @@
+#include "rate_store.hxx"
+#include "rate_record.hxx"
+#include "exceptions.hxx"
+#include <cmath>
+
+using namespace trie;
+
+std::atomic<unsigned long long> RateStore::clamped_rates(0);
+
+RateStore::RateStore(unsigned int rate_table_id) : rate_table_id(rate_table_id), records_count(0) {}
+
+/**
+    Reads back the columns written by write_to, checking the code name ids against the code names count
+*/
+RateStore::RateStore(ctrl::SnapshotReader &reader, uint32_t code_names_count) {
+  rate_table_id = reader.read_value<uint32_t>();
+  records_count = reader.read_value<uint32_t>();
+  for (unsigned char i = 0; i < RATE_TYPES_COUNT; ++i) {
+    rate_columns_t &rate_columns = columns[i];
+    reader.read_vector(rate_columns.current_rate);
+    reader.read_vector(rate_columns.current_effective_date);
+    reader.read_vector(rate_columns.current_end_date);
+    reader.read_vector(rate_columns.future_rate);
+    reader.read_vector(rate_columns.future_effective_date);
+    reader.read_vector(rate_columns.future_end_date);
+    reader.read_vector(rate_columns.egress_trunk_id);
+    for (size_t column_size : {rate_columns.current_rate.size(), rate_columns.current_effective_date.size(),
+                               rate_columns.current_end_date.size(), rate_columns.future_rate.size(),
+                               rate_columns.future_effective_date.size(), rate_columns.future_end_date.size(),
+                               rate_columns.egress_trunk_id.size()})
+      if (column_size != records_count)
+        throw SnapshotInvalidException();
+  }
+  reader.read_vector(code_name_ids);
+  if (code_name_ids.size() != records_count)
+    throw SnapshotInvalidException();
+  for (uint32_t record = 0; record < records_count; ++record)
+    if (code_name_ids[record] != ctrl::NO_CODE_NAME_ID && code_name_ids[record] >= code_names_count)
+      throw SnapshotInvalidException();
+}
+
+fixed_rate_t RateStore::to_fixed_rate(double rate) {
+  if (rate <= 0)
+    return 0;
+  double scaled_rate = std::round(rate * FIXED_RATE_SCALE);
+  if (scaled_rate < 1)
+    return 1;                 // Keep tiny positive rates as existing rates
+  if (scaled_rate >= (double)UINT64_MAX) {   // 2^64 once converted
+    clamped_rates.fetch_add(1, std::memory_order_relaxed);
+    return UINT64_MAX;
+  }
+  return scaled_rate;
+}
+
+/**
+    Returns how many rates were clamped to MAX_FIXED_RATE since the previous call and resets the count
+*/
+unsigned long long RateStore::take_clamped_rates() {
+  return clamped_rates.exchange(0);
+}
+
+double RateStore::from_fixed_rate(fixed_rate_t rate) {
+  if (rate == 0)
+    return -1;
+  return rate / FIXED_RATE_SCALE;
+}
+
+compact_date_t RateStore::to_compact_date(time_t date) {
+  if (date <= 0)
+    return 0;
+  if (date > UINT32_MAX)
+    return UINT32_MAX;
+  return date;
+}
+
+time_t RateStore::from_compact_date(compact_date_t date) {
+  if (date == 0)
+    return -1;
+  return date;
+}
+
+unsigned int RateStore::get_rate_table_id() const {
+  return rate_table_id;
+}
+
+uint32_t RateStore::size() const {
+  return records_count;
+}
+
+/**
+    Appends a copy of the given record to every column and returns its id
+*/
+uint32_t RateStore::add_record(const RateRecord &rate_record) {
+  for (unsigned char i = 0; i < RATE_TYPES_COUNT; ++i) {
+    rate_columns_t &rate_columns = columns[i];
+    const RateRecord::rate_fields_t &rate_fields = rate_record.fields[i];
+    rate_columns.current_rate.push_back(rate_fields.current_rate);
+    rate_columns.current_effective_date.push_back(rate_fields.current_effective_date);
+    rate_columns.current_end_date.push_back(rate_fields.current_end_date);
+    rate_columns.future_rate.push_back(rate_fields.future_rate);
+    rate_columns.future_effective_date.push_back(rate_fields.future_effective_date);
+    rate_columns.future_end_date.push_back(rate_fields.future_end_date);
+    rate_columns.egress_trunk_id.push_back(rate_fields.egress_trunk_id);
+  }
+  code_name_ids.push_back(rate_record.code_item ? rate_record.code_item->second->code_name_id.load(std::memory_order_acquire) : ctrl::NO_CODE_NAME_ID);
+  return records_count++;
+}
+
+/**
+    Copies a stored record back into a rate record, the reverse of add_record
+*/
+void RateStore::copy_record(uint32_t record, RateRecord &rate_record, const ctrl::CodeNames &code_names) const {
+  for (unsigned char i = 0; i < RATE_TYPES_COUNT; ++i) {
+    const rate_columns_t &rate_columns = columns[i];
+    RateRecord::rate_fields_t &rate_fields = rate_record.fields[i];
+    rate_fields.current_rate = rate_columns.current_rate[record];
+    rate_fields.current_effective_date = rate_columns.current_effective_date[record];
+    rate_fields.current_end_date = rate_columns.current_end_date[record];
+    rate_fields.future_rate = rate_columns.future_rate[record];
+    rate_fields.future_effective_date = rate_columns.future_effective_date[record];
+    rate_fields.future_end_date = rate_columns.future_end_date[record];
+    rate_fields.egress_trunk_id = rate_columns.egress_trunk_id[record];
+  }
+  uint32_t code_name_id = code_name_ids[record];
+  rate_record.code_item = code_name_id == ctrl::NO_CODE_NAME_ID ? nullptr : code_names.get_code_item(code_name_id);
+}
+
+void RateStore::shrink_to_fit() {
+  for (unsigned char i = 0; i < RATE_TYPES_COUNT; ++i) {
+    rate_columns_t &rate_columns = columns[i];
+    rate_columns.current_rate.shrink_to_fit();
+    rate_columns.current_effective_date.shrink_to_fit();
+    rate_columns.current_end_date.shrink_to_fit();
+    rate_columns.future_rate.shrink_to_fit();
+    rate_columns.future_effective_date.shrink_to_fit();
+    rate_columns.future_end_date.shrink_to_fit();
+    rate_columns.egress_trunk_id.shrink_to_fit();
+  }
+  code_name_ids.shrink_to_fit();
+}
+
+/**
+    Writes every column, the code name ids included
+*/
+void RateStore::write_to(ctrl::SnapshotWriter &writer) const {
+  writer.write_value<uint32_t>(rate_table_id);
+  writer.write_value<uint32_t>(records_count);
+  for (unsigned char i = 0; i < RATE_TYPES_COUNT; ++i) {
+    const rate_columns_t &rate_columns = columns[i];
+    writer.write_vector(rate_columns.current_rate);
+    writer.write_vector(rate_columns.current_effective_date);
+    writer.write_vector(rate_columns.current_end_date);
+    writer.write_vector(rate_columns.future_rate);
+    writer.write_vector(rate_columns.future_effective_date);
+    writer.write_vector(rate_columns.future_end_date);
+    writer.write_vector(rate_columns.egress_trunk_id);
+  }
+  writer.write_vector(code_name_ids);
+}
+
+double RateStore::get_current_rate(uint32_t record, rate_type_t rate_type) const {
+  return from_fixed_rate(columns[rate_type].current_rate[record]);
+}
+
+time_t RateStore::get_current_effective_date(uint32_t record, rate_type_t rate_type) const {
+  return from_compact_date(columns[rate_type].current_effective_date[record]);
+}
+
+time_t RateStore::get_current_end_date(uint32_t record, rate_type_t rate_type) const {
+  return from_compact_date(columns[rate_type].current_end_date[record]);
+}
+
+double RateStore::get_future_rate(uint32_t record, rate_type_t rate_type) const {
+  return from_fixed_rate(columns[rate_type].future_rate[record]);
+}
+
+time_t RateStore::get_future_effective_date(uint32_t record, rate_type_t rate_type) const {
+  return from_compact_date(columns[rate_type].future_effective_date[record]);
+}
+
+time_t RateStore::get_future_end_date(uint32_t record, rate_type_t rate_type) const {
+  return from_compact_date(columns[rate_type].future_end_date[record]);
+}
+
+unsigned int RateStore::get_egress_trunk_id(uint32_t record, rate_type_t rate_type) const {
+  return columns[rate_type].egress_trunk_id[record];
+}
+
+uint32_t RateStore::get_code_name_id(uint32_t record) const {
+  return code_name_ids[record];
+}
+
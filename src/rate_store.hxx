@@ -0,0 +1,81 @@
+/**
+      Columnar storage of the rate records of a prefix tree
+*/
+#ifndef RATE_STORE_HXX
+#define RATE_STORE_HXX
+
+#include "shared.hxx"
+#include "snapshot_file.hxx"
+#include "code_names.hxx"
+#include <vector>
+#include <string>
+#include <atomic>
+#include <cstdint>
+#include <time.h>
+
+namespace trie {
+
+  class RateStore;
+  class RateRecord;
+  typedef RateStore* p_rate_store_t;
+
+  /** Rates are kept in fixed point, as millionths of the currency unit, wide enough for any real rate */
+  typedef uint64_t fixed_rate_t;
+  /** Dates are kept as 32-bit unsigned epoch seconds */
+  typedef uint32_t compact_date_t;
+
+  const double FIXED_RATE_SCALE = 1000000.0;
+  /** Highest rate a fixed_rate_t holds, about 1.8e13 */
+  const double MAX_FIXED_RATE = UINT64_MAX / FIXED_RATE_SCALE;
+
+  /**
+      Records are addressed by a dense id, and are appended once a prefix tree is frozen.
+      Each field of each rate type has its own column, where zero means "no value": getting a
+      missing one returns -1. Code names are kept as their id in the CodeNames of the generation.
+      Rates above MAX_FIXED_RATE are kept as it, and counted until taken by take_clamped_rates.
+  */
+  class RateStore {
+    private:
+      typedef std::vector<fixed_rate_t> rate_column_t;
+      typedef std::vector<compact_date_t> date_column_t;
+      typedef std::vector<uint32_t> id_column_t;
+      typedef struct {
+        rate_column_t current_rate;
+        date_column_t current_effective_date;
+        date_column_t current_end_date;
+        rate_column_t future_rate;
+        date_column_t future_effective_date;
+        date_column_t future_end_date;
+        id_column_t egress_trunk_id;
+      } rate_columns_t;
+      unsigned int rate_table_id;
+      uint32_t records_count;
+      rate_columns_t columns[RATE_TYPES_COUNT];
+      id_column_t code_name_ids;
+      static std::atomic<unsigned long long> clamped_rates;
+    public:
+      static const uint32_t NO_RECORD = UINT32_MAX;
+      static fixed_rate_t to_fixed_rate(double rate);
+      static unsigned long long take_clamped_rates();
+      static double from_fixed_rate(fixed_rate_t rate);
+      static compact_date_t to_compact_date(time_t date);
+      static time_t from_compact_date(compact_date_t date);
+      RateStore(unsigned int rate_table_id);
+      RateStore(ctrl::SnapshotReader &reader, uint32_t code_names_count);
+      unsigned int get_rate_table_id() const;
+      uint32_t size() const;
+      uint32_t add_record(const RateRecord &rate_record);
+      void copy_record(uint32_t record, RateRecord &rate_record, const ctrl::CodeNames &code_names) const;
+      void shrink_to_fit();
+      void write_to(ctrl::SnapshotWriter &writer) const;
+      double get_current_rate(uint32_t record, rate_type_t rate_type) const;
+      time_t get_current_effective_date(uint32_t record, rate_type_t rate_type) const;
+      time_t get_current_end_date(uint32_t record, rate_type_t rate_type) const;
+      double get_future_rate(uint32_t record, rate_type_t rate_type) const;
+      time_t get_future_effective_date(uint32_t record, rate_type_t rate_type) const;
+      time_t get_future_end_date(uint32_t record, rate_type_t rate_type) const;
+      unsigned int get_egress_trunk_id(uint32_t record, rate_type_t rate_type) const;
+      uint32_t get_code_name_id(uint32_t record) const;
+  };
+}
+#endif
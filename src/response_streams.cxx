@@ -0,0 +1,102 @@
+#include "response_streams.hxx"
+#include <algorithm>
+#include <type_traits>
+#include <cstring>
+
+using namespace rest;
+
+namespace rest {
+
+  /** Callbacks of the slots below SLOTS */
+  template<size_t SLOTS>
+  struct slot_callbacks_t {
+    cycle_callback_ptr callbacks[SLOTS];
+    slot_callbacks_t() {
+      fill(std::integral_constant<size_t, SLOTS>());
+    }
+    void fill(std::integral_constant<size_t, 0>) {}
+    template<size_t SLOT>
+    void fill(std::integral_constant<size_t, SLOT>) {
+      callbacks[SLOT - 1] = &ResponseStreams::write_slot<SLOT - 1>;
+      fill(std::integral_constant<size_t, SLOT - 1>());
+    }
+  };
+}
+
+ResponseStreams::stream_slot_t ResponseStreams::stream_slots[ResponseStreams::SLOTS_COUNT];
+
+cycle_callback_ptr ResponseStreams::get_callback(size_t slot) {
+  static slot_callbacks_t<SLOTS_COUNT> slot_callbacks;
+  return slot_callbacks.callbacks[slot];
+}
+
+/**
+    Fills the buffer with the text left from the last rows written, writing more once it is all
+    sent. Returns -1 at the end of the stream.
+*/
+ssize_t ResponseStreams::write(stream_slot_t &stream_slot, char *buffer, size_t max_size) {
+  std::lock_guard<std::mutex> slot_lock(stream_slot.slot_mutex);
+  if (!stream_slot.result)
+    return -1;
+  stream_slot.last_write = time(nullptr);
+  if (stream_slot.pending_offset == stream_slot.pending.size()) {
+    if (!stream_slot.more_rows) {
+      release(stream_slot);
+      return -1;
+    }
+    stream_slot.pending.clear();
+    stream_slot.pending_offset = 0;
+    stream_slot.more_rows = stream_slot.result->write_json(stream_slot.pending, ROWS_PER_WRITE);
+  }
+  size_t size = std::min(max_size, stream_slot.pending.size() - stream_slot.pending_offset);
+  memcpy(buffer, stream_slot.pending.data() + stream_slot.pending_offset, size);
+  stream_slot.pending_offset += size;
+  return size;
+}
+
+/**
+    Frees the given slot if its stream has been idle for too long: its connection was closed
+    without the end of the stream, and has been for at least a connection timeout
+*/
+void ResponseStreams::reclaim_idle(stream_slot_t &stream_slot, time_t now) {
+  if (!stream_slot.in_use.load())
+    return;
+  std::unique_lock<std::mutex> slot_lock(stream_slot.slot_mutex, std::try_to_lock);
+  if (!slot_lock.owns_lock() || !stream_slot.result || now - stream_slot.last_write < 2 * CONNECTION_TIMEOUT)
+    return;
+  release(stream_slot);
+}
+
+/** Called with the slot locked */
+void ResponseStreams::release(stream_slot_t &stream_slot) {
+  delete stream_slot.result;
+  stream_slot.result = nullptr;
+  std::string().swap(stream_slot.pending);
+  stream_slot.in_use.store(false);
+}
+
+/**
+    Response streaming the JSON of the given result, which it deletes once sent
+*/
+http_response *ResponseStreams::create_response(search::p_search_result_t result, bool sumarize_rate_table) {
+  time_t now = time(nullptr);
+  for (size_t i = 0; i < SLOTS_COUNT; ++i)
+    reclaim_idle(stream_slots[i], now);
+  for (size_t i = 0; i < SLOTS_COUNT; ++i) {
+    stream_slot_t &stream_slot = stream_slots[i];
+    bool in_use = false;
+    if (!stream_slot.in_use.compare_exchange_strong(in_use, true))
+      continue;
+    std::lock_guard<std::mutex> slot_lock(stream_slot.slot_mutex);
+    stream_slot.last_write = now;
+    stream_slot.pending.clear();
+    stream_slot.pending_offset = 0;
+    result->open_json(stream_slot.pending, sumarize_rate_table);
+    stream_slot.more_rows = true;
+    stream_slot.result = result;
+    return new http_response(http_response_builder("", 200, "application/json").deferred_response(get_callback(i)));
+  }
+  std::string json = result->to_json(sumarize_rate_table);
+  delete result;
+  return new http_response(http_response_builder(json, 200, "application/json").string_response());
+}
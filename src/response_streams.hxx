@@ -0,0 +1,55 @@
+/**
+      Search results sent as they are serialized, through deferred HTTP responses
+*/
+#ifndef RESPONSE_STREAMS_HXX
+#define RESPONSE_STREAMS_HXX
+
+#include "search_result.hxx"
+#include <httpserver.hpp>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <time.h>
+
+using namespace httpserver;
+
+namespace rest {
+
+  /**
+      A deferred response is called back with only the buffer to fill, so each stream in flight
+      takes one of a fixed set of slots, each with a callback of its own. The stream writes the
+      JSON of its result a few rows at a time: the whole text is never held in memory.
+      A slot is released once its stream ends. The streams of closed connections are never called
+      back again, so each new stream first takes back every slot idle for twice the connection
+      timeout, freeing its result. Without a free slot the result is sent whole.
+  */
+  class ResponseStreams {
+    private:
+      typedef struct {
+        std::mutex slot_mutex;
+        std::atomic_bool in_use;
+        time_t last_write;
+        search::p_search_result_t result;
+        std::string pending;
+        size_t pending_offset;
+        bool more_rows;
+      } stream_slot_t;
+      static const size_t SLOTS_COUNT = 32;
+      static const size_t ROWS_PER_WRITE = 256;
+      static stream_slot_t stream_slots[SLOTS_COUNT];
+      template<size_t SLOT>
+      static ssize_t write_slot(char *buffer, size_t max_size) {
+        return write(stream_slots[SLOT], buffer, max_size);
+      }
+      template<size_t SLOTS>
+      friend struct slot_callbacks_t;
+      static cycle_callback_ptr get_callback(size_t slot);
+      static ssize_t write(stream_slot_t &stream_slot, char *buffer, size_t max_size);
+      static void reclaim_idle(stream_slot_t &stream_slot, time_t now);
+      static void release(stream_slot_t &stream_slot);
+    public:
+      static const int CONNECTION_TIMEOUT = 180;
+      static http_response *create_response(search::p_search_result_t result, bool sumarize_rate_table = true);
+  };
+}
+#endif
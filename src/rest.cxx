@@ -1,5 +1,6 @@
 #include "rest.hxx"
 #include "rest_resources.hxx"
+#include "response_streams.hxx"
 #include "logger.hxx"
 #include <iostream>
 
@@ -7,13 +8,15 @@ using namespace rest;
 
 void Rest::run_server(unsigned int http_listen_port) {
   ctrl::log("Listening HTTP server at port " + std::to_string(http_listen_port) + "...");
-  webserver server = create_webserver(http_listen_port).max_threads(10);
+  webserver server = create_webserver(http_listen_port).max_threads(10).connection_timeout(ResponseStreams::CONNECTION_TIMEOUT);
   RestSearchCode search_code;
+  RestSearchCodes search_codes;
   RestSearchCodeName search_code_name;
   RestSearchCodeNameAndRateTable search_code_name_rate_table, search_code_name_rate_table_codes(false);
   RestSearchRateTable search_rate_table;
   RestSearchAllCodeNames search_all_codes;
   server.register_resource("/search_code", &search_code, true);
+  server.register_resource("/search_codes", &search_codes, true);
   server.register_resource("/search_code_name", &search_code_name, true);
   server.register_resource("/search_code_name_rate_table", &search_code_name_rate_table, true);
   server.register_resource("/search_code_name_rate_table_codes", &search_code_name_rate_table_codes, true);
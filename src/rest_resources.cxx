@@ -1,9 +1,63 @@
 #include "rest_resources.hxx"
 #include "controller.hxx"
+#include "response_streams.hxx"
 #include <iostream>
+#include <stdexcept>
+#include <memory>
+#include <sstream>
+#include <algorithm>
 
 using namespace rest;
 
+/**
+    Count of rows of a page argument, 0 if it is not given. Only plain decimal numbers, as telnet
+    takes them: no sign, no leading zeros and nothing after the digits.
+*/
+static size_t page_count_arg(const http_request& request, const std::string &name) {
+  std::string arg = request.get_arg(name);
+  if (arg == "")
+    return 0;
+  unsigned long count = std::stoul(arg);
+  if (std::to_string(count) != arg)
+    throw std::invalid_argument("Invalid " + name);
+  return count;
+}
+
+/**
+    Limits the result to the page asked by the limit and offset arguments, or by the cursor
+    returned with the previous page
+*/
+static void set_result_page(const http_request& request, search::SearchResult &result, bool sumarize_rate_table = true) {
+  std::string arg_cursor = request.get_arg("cursor");
+  if (!result.set_page(page_count_arg(request, "offset"), page_count_arg(request, "limit"), sumarize_rate_table))
+    throw std::invalid_argument("Invalid page");
+  if (arg_cursor != "" && !result.set_cursor(arg_cursor))
+    throw std::invalid_argument("Invalid cursor");
+}
+
+/**
+    Whether the binary format of the results is asked, by the format argument or else by the
+    Accept header
+*/
+static bool binary_format(const http_request& request) {
+  std::string arg_format = request.get_arg("format");
+  if (arg_format == "binary")
+    return true;
+  if (arg_format == "json")
+    return false;
+  if (arg_format != "")
+    throw std::invalid_argument("Invalid format");
+  return request.get_header("Accept").find(search::BINARY_CONTENT_TYPE) != std::string::npos;
+}
+
+static http_response *result_response(search::SearchResult &result, bool binary, bool sumarize_rate_table = true) {
+  if (result.is_stale())
+    return new http_response(http_response_builder("Stale cursor: the rate tables were reloaded", 410, "text/plain").string_response());
+  if (binary)
+    return new http_response(http_response_builder(result.to_binary(sumarize_rate_table), 200, search::BINARY_CONTENT_TYPE).string_response());
+  return new http_response(http_response_builder(result.to_json(sumarize_rate_table), 200, "application/json").string_response());
+}
+
 void RestSearchCode::render(const http_request& request, http_response** response) {
   try {
     std::string arg_code = request.get_arg("code");
@@ -12,10 +66,60 @@ void RestSearchCode::render(const http_request& request, http_response** respons
     trie::rate_type_t rate_type = trie::to_rate_type_t(arg_rate_type);
     unsigned int days_ahead = arg_days_ahead == "" ? 7 : std::stoul(arg_days_ahead);
     search::SearchResult result(days_ahead);
+    set_result_page(request, result);
+    bool binary = binary_format(request);
     ctrl::p_controller_t p_controller = ctrl::Controller::get_controller();
     unsigned long long code = stoull(arg_code);
     p_controller->search_code(code, rate_type, result);
-    *response = new http_response(http_response_builder(result.to_json(), 200, "application/json").string_response());
+    *response = result_response(result, binary);
+  } catch (std::exception &e) {
+    *response = new http_response(http_response_builder("Error", 400, "text/plain").string_response());
+  }
+}
+
+/**
+    Answers with the result of each code, in the order of the lines: a JSON array of the same
+    objects as /search_code, or binary messages one after the other
+*/
+void RestSearchCodes::render(const http_request& request, http_response** response) {
+  try {
+    if (request.get_method() != "POST") {
+      *response = new http_response(http_response_builder("Codes must be posted", 405, "text/plain").string_response());
+      return;
+    }
+    ctrl::code_queries_t code_queries;
+    std::istringstream lines(request.get_content());
+    std::string line;
+    while (std::getline(lines, line)) {
+      line.erase(std::remove(line.begin(), line.end(), '\r'), line.end());
+      if (line == "")
+        continue;
+      if (code_queries.size() == ctrl::MAX_CODE_QUERIES) {
+        *response = new http_response(http_response_builder("Too many codes: at most " + std::to_string(ctrl::MAX_CODE_QUERIES) + " per request",
+                                                            413, "text/plain").string_response());
+        return;
+      }
+      code_queries.push_back(ctrl::parse_code_query(line));
+    }
+    bool binary = binary_format(request);
+    std::vector<std::unique_ptr<search::SearchResult>> results;
+    std::vector<search::p_search_result_t> batch_results;
+    for (auto it = code_queries.begin(); it != code_queries.end(); ++it) {
+      results.emplace_back(new search::SearchResult(it->days_ahead));
+      batch_results.push_back(results.back().get());
+    }
+    ctrl::p_controller_t p_controller = ctrl::Controller::get_controller();
+    p_controller->search_code_batch(code_queries, batch_results);
+    std::string output = binary ? "" : "[\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+      if (binary)
+        output += results[i]->to_binary();
+      else
+        output += (i ? ",\n" : "") + results[i]->to_json();
+    }
+    if (!binary)
+      output += "]\n";
+    *response = new http_response(http_response_builder(output, 200, binary ? search::BINARY_CONTENT_TYPE : "application/json").string_response());
   } catch (std::exception &e) {
     *response = new http_response(http_response_builder("Error", 400, "text/plain").string_response());
   }
@@ -29,9 +133,11 @@ void RestSearchCodeName::render(const http_request& request, http_response** res
     trie::rate_type_t rate_type = trie::to_rate_type_t(arg_rate_type);
     unsigned int days_ahead = arg_days_ahead == "" ? 7 : std::stoul(arg_days_ahead);
     search::SearchResult result(days_ahead);
+    set_result_page(request, result);
+    bool binary = binary_format(request);
     ctrl::p_controller_t p_controller = ctrl::Controller::get_controller();
     p_controller->search_code_name(code_name, rate_type, result);
-    *response = new http_response(http_response_builder(result.to_json(), 200, "application/json").string_response());
+    *response = result_response(result, binary);
   } catch (std::exception &e) {
     *response = new http_response(http_response_builder("Error", 400, "text/plain").string_response());
   }
@@ -46,10 +152,12 @@ void RestSearchCodeNameAndRateTable::render(const http_request& request, http_re
     trie::rate_type_t rate_type = trie::to_rate_type_t(arg_rate_type);
     unsigned int days_ahead = arg_days_ahead == "" ? 7 : std::stoul(arg_days_ahead);
     search::SearchResult result(days_ahead);
+    set_result_page(request, result, sumarize_rate_table);
+    bool binary = binary_format(request);
     ctrl::p_controller_t p_controller = ctrl::Controller::get_controller();
     unsigned int rate_table_id = stoul(arg_rate_table_id);
     p_controller->search_code_name_rate_table(code_name, rate_table_id, rate_type, result, !sumarize_rate_table);
-    *response = new http_response(http_response_builder(result.to_json(sumarize_rate_table), 200, "application/json").string_response());
+    *response = result_response(result, binary, sumarize_rate_table);
   } catch (std::exception &e) {
     *response = new http_response(http_response_builder("Error", 400, "text/plain").string_response());
   }
@@ -63,11 +171,16 @@ void RestSearchRateTable::render(const http_request& request, http_response** re
     std::string arg_days_ahead = request.get_arg("days_ahead");
     trie::rate_type_t rate_type = trie::to_rate_type_t(arg_rate_type);
     unsigned int days_ahead = arg_days_ahead == "" ? 7 : std::stoul(arg_days_ahead);
-    search::SearchResult result(days_ahead);
+    std::unique_ptr<search::SearchResult> result(new search::SearchResult(days_ahead));
+    set_result_page(request, *result);
+    bool binary = binary_format(request);
     ctrl::p_controller_t p_controller = ctrl::Controller::get_controller();
     unsigned int rate_table_id = stoul(arg_rate_table_id);
-    p_controller->search_rate_table(rate_table_id, rate_type, result);
-    *response = new http_response(http_response_builder(result.to_json(), 200, "application/json").string_response());
+    p_controller->search_rate_table(rate_table_id, rate_type, *result);
+    if (result->is_stale() || binary)
+      *response = result_response(*result, binary);
+    else
+      *response = ResponseStreams::create_response(result.release());
   } catch (std::exception &e) {
     *response = new http_response(http_response_builder("Error", 400, "text/plain").string_response());
   }
@@ -79,10 +192,15 @@ void RestSearchAllCodeNames::render(const http_request& request, http_response**
     trie::rate_type_t rate_type = trie::to_rate_type_t(arg_rate_type);
     std::string arg_days_ahead = request.get_arg("days_ahead");
     unsigned int days_ahead = arg_days_ahead == "" ? 7 : std::stoul(arg_days_ahead);
-    search::SearchResult result(days_ahead);
+    std::unique_ptr<search::SearchResult> result(new search::SearchResult(days_ahead));
+    set_result_page(request, *result);
+    bool binary = binary_format(request);
     ctrl::p_controller_t p_controller = ctrl::Controller::get_controller();
-    p_controller->search_all_codes(rate_type, result);
-    *response = new http_response(http_response_builder(result.to_json(), 200, "application/json").string_response());
+    p_controller->search_all_codes(rate_type, *result);
+    if (result->is_stale() || binary)
+      *response = result_response(*result, binary);
+    else
+      *response = ResponseStreams::create_response(result.release());
   } catch (std::exception &e) {
     *response = new http_response(http_response_builder("Error", 400, "text/plain").string_response());
   }
@@ -12,6 +12,12 @@ namespace rest {
       void render(const http_request& request, http_response** response);
   };
 
+  /** Batch lookup: POST one code per line, as code[,rate_type[,days_ahead]] */
+  class RestSearchCodes : public http_resource <RestSearchCodes> {
+  	public:
+      void render(const http_request& request, http_response** response);
+  };
+
   class RestSearchCodeName : public http_resource <RestSearchCodeName> {
   	public:
       void render(const http_request& request, http_response** response);
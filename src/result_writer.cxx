@@ -0,0 +1,107 @@
+#include "result_writer.hxx"
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <cstring>
+
+using namespace search;
+
+ResultWriter::ResultWriter(std::string &output) : output(output) {
+  for (size_t i = 0; i < DATE_CACHE_SIZE; ++i)
+    date_cache[i].day = -1;
+}
+
+void ResultWriter::write(const char *text, size_t length) {
+  output.append(text, length);
+}
+
+void ResultWriter::write(const std::string &text) {
+  output.append(text);
+}
+
+void ResultWriter::write_number(unsigned long long value) {
+  char digits[20];
+  size_t length = 0;
+  do {
+    digits[sizeof(digits) - ++length] = '0' + value % 10;
+    value /= 10;
+  } while (value);
+  output.append(digits + sizeof(digits) - length, length);
+}
+
+/**
+    Six decimals, as "%f". The digits are taken from the rate scaled to an integer unless the
+    rate is too close to halfway between two of them to be sure it rounds as printf does.
+*/
+void ResultWriter::write_rate(double rate) {
+  double scaled = std::fabs(rate) * 1e6;
+  double rounded = std::nearbyint(scaled);
+  if (!(scaled < 1e15) || std::fabs(std::fabs(scaled - rounded) - 0.5) < 1e-6) {
+    char text[64];
+    int length = snprintf(text, sizeof(text), "%f", rate);
+    output.append(text, length > 0 ? length : 0);
+    return;
+  }
+  unsigned long long units = (unsigned long long)rounded;
+  if (std::signbit(rate))
+    output += '-';
+  write_number(units / 1000000);
+  char decimals[7] = { '.' };
+  unsigned long long fraction = units % 1000000;
+  for (size_t i = 6; i > 0; --i) {
+    decimals[i] = '0' + fraction % 10;
+    fraction /= 10;
+  }
+  output.append(decimals, sizeof(decimals));
+}
+
+/**
+    Nothing for dates up to the epoch, which mean no date
+*/
+void ResultWriter::write_date(time_t epoch_date) {
+  if (epoch_date <= 0)
+    return;
+  long long day = epoch_date / 86400;
+  long long second = epoch_date % 86400;
+  cached_day_t &cached_day = date_cache[day % DATE_CACHE_SIZE];
+  if (cached_day.day != day) {
+    struct tm date;
+    char text[DAY_LENGTH + 1];
+    gmtime_r(&epoch_date, &date);
+    if (strftime(text, sizeof(text), "%Y-%m-%d", &date) != DAY_LENGTH) {
+      char buffer_date[100];
+      output.append(buffer_date, strftime(buffer_date, sizeof(buffer_date), "%Y-%m-%d %T%z", &date));
+      return;
+    }
+    cached_day.day = day;
+    std::copy(text, text + DAY_LENGTH, cached_day.text);
+  }
+  char time_of_day[] = " 00:00:00+0000";
+  time_of_day[1] += second / 36000;
+  time_of_day[2] += second / 3600 % 10;
+  time_of_day[4] += second % 3600 / 600;
+  time_of_day[5] += second % 600 / 60;
+  time_of_day[7] += second % 60 / 10;
+  time_of_day[8] += second % 10;
+  output.append(cached_day.text, DAY_LENGTH);
+  output.append(time_of_day, sizeof(time_of_day) - 1);
+}
+
+/**
+    The given count of low bytes of the value, least significant first
+*/
+void ResultWriter::write_binary(uint64_t value, size_t size) {
+  char bytes[8];
+  for (size_t i = 0; i < size; ++i, value >>= 8)
+    bytes[i] = (char)(value & 0xff);
+  output.append(bytes, size);
+}
+
+/**
+    IEEE 754 double, as its 8 bytes
+*/
+void ResultWriter::write_binary_rate(double rate) {
+  uint64_t bits;
+  memcpy(&bits, &rate, sizeof(bits));
+  write_binary(bits, sizeof(bits));
+}
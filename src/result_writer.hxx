@@ -0,0 +1,47 @@
+/**
+      Appending of search result fields to an output string, without temporaries
+*/
+#ifndef RESULT_WRITER_HXX
+#define RESULT_WRITER_HXX
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <time.h>
+
+namespace search {
+
+  class ResultWriter;
+
+  /**
+      Writes the same text as std::to_string and strftime("%Y-%m-%d %T%z") on gmtime would.
+      The date of each day is formatted once and kept in a small cache, the time of day is
+      computed directly. Binary values are written little-endian, whatever the host order.
+      Not thread-safe: each thread writes through its own writer.
+  */
+  class ResultWriter {
+    private:
+      static const size_t DATE_CACHE_SIZE = 64;
+      static const size_t DAY_LENGTH = 10;
+      typedef struct {
+        long long day;
+        char text[DAY_LENGTH];
+      } cached_day_t;
+      std::string &output;
+      cached_day_t date_cache[DATE_CACHE_SIZE];
+    public:
+      ResultWriter(std::string &output);
+      void write(const char *text, size_t length);
+      void write(const std::string &text);
+      template<size_t N>
+      void write(const char (&text)[N]) {
+        write(text, N - 1);
+      }
+      void write_number(unsigned long long value);
+      void write_rate(double rate);
+      void write_date(time_t epoch_date);
+      void write_binary(uint64_t value, size_t size);
+      void write_binary_rate(double rate);
+  };
+}
+#endif
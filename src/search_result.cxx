@@ -1,16 +1,22 @@
 #include "search_result.hxx"
-#include "code.hxx"
 #include <time.h>
+#include <functional>
+#include <algorithm>
+#include <iterator>
+#include <set>
+#include <tuple>
 #include <iostream>
 #include <chrono>
+#include <cstdint>
+#include <stdexcept>
 
 using namespace search;
 
-SearchResultElement::SearchResultElement(unsigned long long code, std::string code_name, unsigned long long rate_table_id, trie::rate_type_t rate_type,
+SearchResultElement::SearchResultElement(unsigned long long code, uint32_t code_name_id, unsigned long long rate_table_id, trie::rate_type_t rate_type,
       double current_min_rate, double current_max_rate, double future_min_rate, double future_max_rate,
       time_t effective_date, time_t end_date, time_t future_effective_date, time_t future_end_date, unsigned int egress_trunk_id)
         : code(code),
-          code_name(code_name),
+          code_name_id(code_name_id),
           rate_table_id(rate_table_id),
           rate_type(rate_type),
           current_min_rate(current_min_rate),
@@ -23,7 +29,7 @@ SearchResultElement::SearchResultElement(unsigned long long code, std::string co
           future_end_date(future_end_date),
           egress_trunk_id(egress_trunk_id) {}
 
-bool SearchResultElement::operator >(SearchResultElement &other) const {
+bool SearchResultElement::operator >(const SearchResultElement &other) const {
   if (this->current_max_rate > other.current_max_rate)
     return true;
   else if (this->current_max_rate == other.current_max_rate) {
@@ -39,8 +45,8 @@ unsigned long long SearchResultElement::get_code() {
     return code;
 }
 
-std::string SearchResultElement::get_code_name() {
-  return code_name;
+uint32_t SearchResultElement::get_code_name_id() {
+  return code_name_id;
 }
 
 unsigned long long SearchResultElement::get_rate_table_id() {
@@ -87,19 +93,37 @@ unsigned int SearchResultElement::get_egress_trunk_id() {
   return egress_trunk_id;
 }
 
-SearchResult::SearchResult(unsigned int days_ahead) : days_ahead(days_ahead) {
-  data = new search_result_elements_t();
+bool search::same_rank(const search_match_t &a, const search_match_t &b) {
+  return a.current_max_rate == b.current_max_rate && a.code == b.code && a.rate_table_id == b.rate_table_id;
 }
 
-SearchResult::~SearchResult() {
-  for (auto it = data->begin(); it != data->end(); ++it)
-    delete *it;
-  data->clear();
-  delete data;
+bool search::ranks_before(const search_match_t &a, const search_match_t &b) {
+  if (!same_rank(a, b))
+    return a.current_max_rate > b.current_max_rate ||
+           (a.current_max_rate == b.current_max_rate && (a.code > b.code || (a.code == b.code && a.rate_table_id > b.rate_table_id)));
+  return std::tie(a.current_min_rate, a.future_max_rate, a.future_min_rate, a.effective_date, a.end_date,
+                  a.future_effective_date, a.future_end_date, a.egress_trunk_id, a.code_name_id) >
+         std::tie(b.current_min_rate, b.future_max_rate, b.future_min_rate, b.effective_date, b.end_date,
+                  b.future_effective_date, b.future_end_date, b.egress_trunk_id, b.code_name_id);
 }
 
+/**
+    Matches are buffered in the given arena, shared by the results of a task, or else through
+    the scalable allocator
+*/
+SearchResult::SearchResult(unsigned int days_ahead, ctrl::p_arena_t shared_arena)
+  : days_ahead(days_ahead),
+    page_offset(0),
+    page_limit(0),
+    page_sumarize_rate_table(true),
+    generation_id(0),
+    stale(false),
+    more_rows(false),
+    stream_row(0),
+    match_buffers(match_buffer_t(MatchAllocator<search_match_t>(shared_arena))) {}
+
 void SearchResult::insert(unsigned long long code,
-                          std::string code_name,
+                          uint32_t code_name_id,
                           unsigned long long rate_table_id,
                           trie::rate_type_t rate_type,
                           double current_min_rate,
@@ -112,13 +136,109 @@ void SearchResult::insert(unsigned long long code,
                           time_t future_end_date,
                           time_t reference_time,
                           unsigned int egress_trunk_id) {
-  tbb::mutex::scoped_lock lock(search_insertion_mutex);
+  search_match_t match = { code, code_name_id, rate_table_id, rate_type, current_min_rate, current_max_rate, future_min_rate, future_max_rate,
+                           effective_date, end_date, future_effective_date, future_end_date, reference_time, egress_trunk_id };
+  match_buffer_t &match_buffer = match_buffers.local();
+  match_buffer.push_back(match);
+  if (page_limit && match_buffer.size() / 2 >= kept_rows_count())
+    match_buffer.erase(match_buffer.begin() + (keep_ranked(match_buffer.data(), match_buffer.data() + match_buffer.size(), false) - match_buffer.data()),
+                       match_buffer.end());
+}
+
+/**
+    Shows the rows from offset on, at most limit of them (0 for all). Rows are the elements of
+    the ranking, or its first element of each rate table when summarized: the same summarization
+    must be asked to to_json or to_text_table. Returns false, leaving the page as it was, if the
+    rows up to the one after the page can't be counted in a size_t.
+*/
+bool SearchResult::set_page(size_t offset, size_t limit, bool sumarize_rate_table) {
+  size_t rows_count;
+  if (__builtin_add_overflow(offset, limit, &rows_count) || rows_count == SIZE_MAX)
+    return false;
+  page_offset = offset;
+  page_limit = limit;
+  page_sumarize_rate_table = sumarize_rate_table;
+  return true;
+}
+
+/**
+    Continues where the page of the given cursor stopped, in the same generation. Returns false
+    if the cursor isn't one of get_next_cursor.
+*/
+bool SearchResult::set_cursor(const std::string &cursor) {
+  size_t separator = cursor.find('.');
+  if (separator == std::string::npos || separator == 0 || separator + 1 == cursor.size() ||
+      cursor.find_first_not_of("0123456789.") != std::string::npos || cursor.find('.', separator + 1) != std::string::npos)
+    return false;
+  std::string cursor_generation_id = cursor.substr(0, separator);
+  std::string cursor_offset = cursor.substr(separator + 1);
+  unsigned long long parsed_generation_id;
+  unsigned long long offset;
+  try {
+    parsed_generation_id = std::stoull(cursor_generation_id);
+    offset = std::stoull(cursor_offset);
+  } catch (std::out_of_range &e) {
+    return false;
+  }
+  if (std::to_string(parsed_generation_id) != cursor_generation_id || std::to_string(offset) != cursor_offset ||
+      offset > SIZE_MAX || !set_page(offset, page_limit, page_sumarize_rate_table))
+    return false;
+  generation_id = parsed_generation_id;
+  return true;
+}
+
+/**
+    Called by the searches with the generation pinned: returns false, and searches nothing, if the
+    page was asked for another generation
+*/
+bool SearchResult::pin_generation(unsigned long long searched_generation_id) {
+  if (generation_id && generation_id != searched_generation_id) {
+    stale = true;
+    return false;
+  }
+  generation_id = searched_generation_id;
+  return true;
+}
+
+bool SearchResult::is_stale() const {
+  return stale;
+}
+
+/**
+    Cursor of the next page, empty after the last one. Set once the result has been serialized.
+*/
+std::string SearchResult::get_next_cursor() const {
+  if (!more_rows)
+    return "";
+  return std::to_string(generation_id) + "." + std::to_string(page_offset + page_limit);
+}
+
+/**
+    Rows a page needs ranked: its own, the ones before it and the one after it that tells if
+    there are more. All of them when there is no limit.
+*/
+size_t SearchResult::kept_rows_count() const {
+  size_t rows_count;
+  if (!page_limit || __builtin_add_overflow(page_offset, page_limit, &rows_count) || rows_count == SIZE_MAX)
+    return SIZE_MAX;
+  return rows_count + 1;
+}
+
+/**
+    Element shown for a match: the future rates are the ones in effect days_ahead after the reference time
+*/
+SearchResultElement SearchResult::to_element(const search_match_t &match) const {
+  double future_min_rate = match.future_min_rate;
+  double future_max_rate = match.future_max_rate;
+  time_t end_date = match.end_date;
+  time_t future_effective_date = match.future_effective_date;
+  time_t future_end_date = match.future_end_date;
   if (future_effective_date != -1 && end_date == -1)
     end_date = future_effective_date - 1;
-  time_t future_date = reference_time + 3600 * 24 * days_ahead;
+  time_t future_date = match.reference_time + 3600 * 24 * days_ahead;
   if (end_date <= 0) {
-    future_max_rate = current_max_rate;
-    future_min_rate = current_min_rate;
+    future_max_rate = match.current_max_rate;
+    future_min_rate = match.current_min_rate;
     future_effective_date = future_date;
     future_end_date =  -1;
   }
@@ -140,146 +260,410 @@ void SearchResult::insert(unsigned long long code,
       future_min_rate = -1;
     }
   }
+  return SearchResultElement(match.code, match.code_name_id, match.rate_table_id, match.rate_type, match.current_min_rate, match.current_max_rate,
+                             future_min_rate, future_max_rate, match.effective_date, end_date,
+                             future_effective_date, future_end_date, match.egress_trunk_id);
+}
 
-  data->insert(new SearchResultElement(code, code_name, rate_table_id, rate_type, current_min_rate, current_max_rate,
-                          future_min_rate, future_max_rate, effective_date, end_date,
-                          future_effective_date, future_end_date, egress_trunk_id));
+/**
+    Sorts the given matches into the ranking, keeping the first one of equal rank, and, for a
+    page, only the ones that may show up in it. Returns the end of the matches kept.
+*/
+search_match_t *SearchResult::keep_ranked(search_match_t *begin, search_match_t *end, bool in_parallel) const {
+  if (in_parallel)
+    tbb::parallel_sort(begin, end, ranks_before);
+  else
+    std::sort(begin, end, ranks_before);
+  end = std::unique(begin, end, same_rank);
+  size_t rows_count = kept_rows_count();
+  if (rows_count == SIZE_MAX)
+    return end;
+  if (!page_sumarize_rate_table)
+    return begin + std::min(rows_count, (size_t)(end - begin));
+  std::set<unsigned long long> rate_table_ids;
+  search_match_t *kept_end = begin;
+  for (search_match_t *it = begin; it != end && rate_table_ids.size() < rows_count; ++it)
+    if (rate_table_ids.insert(it->rate_table_id).second)
+      *kept_end++ = *it;
+  return kept_end;
 }
 
-void SearchResult::convert_date(time_t epoch_date, std::string &readable_date) {
-  readable_date = "";
-  if (epoch_date > 0) {
-    char buffer_date[100];
-    strftime(buffer_date, 100, "%Y-%m-%d %T%z", gmtime(&epoch_date));
-    readable_date = std::string(buffer_date);
+/**
+    Sorts the buffered matches into the ranking, keeping the first one of equal rank. Elements
+    already ranked win over new ones of equal rank. Not thread-safe against insertions.
+*/
+void SearchResult::merge() {
+  search_matches_t matches;
+  take_matches(matches);
+  if (matches.empty())
+    return;
+  matches.erase(matches.begin() + (keep_ranked(matches.data(), matches.data() + matches.size(), true) - matches.data()), matches.end());
+  search_result_elements_t elements;
+  elements.reserve(matches.size());
+  for (auto it = matches.begin(); it != matches.end(); ++it)
+    elements.push_back(to_element(*it));
+  if (data.empty()) {
+    data.swap(elements);
+    return;
   }
+  search_result_elements_t merged_elements;
+  merged_elements.reserve(data.size() + elements.size());
+  std::set_union(data.begin(), data.end(), elements.begin(), elements.end(), std::back_inserter(merged_elements), compare_elements_t());
+  data.swap(merged_elements);
 }
 
-std::string SearchResult::to_json(bool sumarize_rate_table) {
+/**
+    Moves the matches inserted so far, as they were inserted, to the given matches
+*/
+void SearchResult::take_matches(search_matches_t &matches) {
+  size_t matches_count = matches.size();
+  for (auto it = match_buffers.begin(); it != match_buffers.end(); ++it)
+    matches_count += it->size();
+  matches.reserve(matches_count);
+  for (auto it = match_buffers.begin(); it != match_buffers.end(); ++it) {
+    matches.insert(matches.end(), it->begin(), it->end());
+    it->clear();
+  }
+}
+
+/**
+    Copies the names of the code names found so far, out of the code names of the searched generation
+*/
+void SearchResult::resolve_code_names(const ctrl::CodeNames &generation_code_names) {
+  merge();
+  for (auto it = data.begin(); it != data.end(); ++it) {
+    uint32_t code_name_id = it->get_code_name_id();
+    if (code_name_id != ctrl::NO_CODE_NAME_ID && code_name_id < generation_code_names.size() && code_names.find(code_name_id) == code_names.end())
+      code_names[code_name_id] = generation_code_names.get_code_name(code_name_id);
+  }
+}
+
+const std::string &SearchResult::get_code_name(uint32_t code_name_id) const {
+  static const std::string no_code_name = "";
+  code_names_t::const_iterator it = code_names.find(code_name_id);
+  if (it == code_names.end())
+    return no_code_name;
+  return it->second;
+}
+
+/**
+    Whether the given row, counted from the first one, is in the page. Notes the rows left after it.
+*/
+bool SearchResult::in_page(size_t row) {
+  if (row < page_offset)
+    return false;
+  if (page_limit && row - page_offset >= page_limit) {
+    more_rows = true;
+    return false;
+  }
+  return true;
+}
+
+/**
+    Rows shown: the elements of the page, only the first one of each rate table when summarized
+*/
+void SearchResult::select_rows(bool sumarize_rate_table, rows_t &rows) {
+  merge();
   std::set<unsigned int> rate_table_ids;
-  std::string json = "{  \"rank\" : [\n";
-  for (auto it = data->begin(); it != data->end(); ++it) {
-    unsigned int rate_table_id = (*it)->get_rate_table_id();
-    if (sumarize_rate_table) {
-      if (rate_table_ids.find(rate_table_id) !=  rate_table_ids.end())
-        continue;
-      rate_table_ids.insert(rate_table_id);
-    }
-    time_t epoch_effective_date = (*it)->get_effective_date();
-    time_t epoch_end_date = (*it)->get_end_date();
-    std::string effective_date;
-    std::string end_date;
-    convert_date(epoch_effective_date, effective_date);
-    convert_date(epoch_end_date, end_date);
-    double future_max_rate = (*it)->get_future_max_rate();
-    if (it != data->begin() )
-        json += ",\n";
-    json += "\t\t{\n";
-    unsigned long long code = (*it)->get_code();
-    if (code != 0)
-      json += "\t\t\t\"code\" : " + std::to_string(code) + ",\n";
-    json += "\t\t\t\"code_name\" : \"" + (*it)->get_code_name() + "\",\n";
-    json += "\t\t\t\"rate_type\" : \"" + trie::rate_type_to_string((*it)->get_rate_type()) + "\",\n";
-    json += "\t\t\t\"rate_table_id\" : " + std::to_string(rate_table_id) + ",\n";
-    json += "\t\t\t\"egress_trunk_id\" : " + std::to_string((*it)->get_egress_trunk_id()) + ",\n";
-    json += "\t\t\t\"current_max_rate\" : " + std::to_string((*it)->get_current_max_rate()) + ",\n";
-    json += "\t\t\t\"current_min_rate\" : " + std::to_string((*it)->get_current_min_rate()) + ",\n";
-    json += "\t\t\t\"effective_date\" : \"" + effective_date + "\",\n";
-    if (epoch_end_date <= 0)
-      json += "\t\t\t\"end_date\" : null\n";
+  size_t row = 0;
+  more_rows = false;
+  for (auto it = data.begin(); it != data.end() && !more_rows; ++it) {
+    if (sumarize_rate_table && !rate_table_ids.insert(it->get_rate_table_id()).second)
+      continue;
+    if (in_page(row++))
+      rows.push_back(&*it);
+  }
+}
+
+/**
+    Appends the given rows to the output, large results in chunks written in parallel and then
+    copied one after the other
+*/
+void SearchResult::write_rows(const rows_t &rows, size_t row_size, const write_row_t &write_row, std::string &output) const {
+  if (rows.size() <= ROWS_PER_CHUNK) {
+    output.reserve(output.size() + rows.size() * row_size);
+    ResultWriter writer(output);
+    for (size_t i = 0; i < rows.size(); ++i)
+      write_row(writer, *rows[i], i);
+    return;
+  }
+  std::vector<std::string> chunks((rows.size() + ROWS_PER_CHUNK - 1) / ROWS_PER_CHUNK);
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, chunks.size()),
+    [&](const tbb::blocked_range<size_t> &r) {
+      for (size_t chunk = r.begin(); chunk != r.end(); ++chunk) {
+        size_t rows_end = std::min(rows.size(), (chunk + 1) * ROWS_PER_CHUNK);
+        chunks[chunk].reserve(ROWS_PER_CHUNK * row_size);
+        ResultWriter writer(chunks[chunk]);
+        for (size_t i = chunk * ROWS_PER_CHUNK; i < rows_end; ++i)
+          write_row(writer, *rows[i], i);
+      }
+    });
+  size_t output_size = output.size();
+  for (auto it = chunks.begin(); it != chunks.end(); ++it)
+    output_size += it->size();
+  output.reserve(output_size);
+  for (auto it = chunks.begin(); it != chunks.end(); ++it)
+    output += *it;
+}
+
+void SearchResult::write_json_row(ResultWriter &writer, SearchResultElement &element, size_t row) const {
+  if (row > 0)
+    writer.write(",\n");
+  writer.write("\t\t{\n");
+  unsigned long long code = element.get_code();
+  if (code != 0) {
+    writer.write("\t\t\t\"code\" : ");
+    writer.write_number(code);
+    writer.write(",\n");
+  }
+  writer.write("\t\t\t\"code_name\" : \"");
+  writer.write(get_code_name(element.get_code_name_id()));
+  writer.write("\",\n\t\t\t\"rate_type\" : \"");
+  writer.write(trie::rate_type_to_string(element.get_rate_type()));
+  writer.write("\",\n\t\t\t\"rate_table_id\" : ");
+  writer.write_number((unsigned int)element.get_rate_table_id());
+  writer.write(",\n\t\t\t\"egress_trunk_id\" : ");
+  writer.write_number(element.get_egress_trunk_id());
+  writer.write(",\n\t\t\t\"current_max_rate\" : ");
+  writer.write_rate(element.get_current_max_rate());
+  writer.write(",\n\t\t\t\"current_min_rate\" : ");
+  writer.write_rate(element.get_current_min_rate());
+  writer.write(",\n\t\t\t\"effective_date\" : \"");
+  writer.write_date(element.get_effective_date());
+  writer.write("\",\n");
+  time_t epoch_end_date = element.get_end_date();
+  if (epoch_end_date <= 0)
+    writer.write("\t\t\t\"end_date\" : null\n");
+  else {
+    writer.write("\t\t\t\"end_date\" : \"");
+    writer.write_date(epoch_end_date);
+    writer.write("\"\n");
+  }
+  double future_max_rate = element.get_future_max_rate();
+  if (future_max_rate <= 0) {
+    writer.write("\t\t\t\"future_max_rate\" : null,\n");
+    writer.write("\t\t\t\"future_min_rate\" : null,\n");
+    writer.write("\t\t\t\"future_effective_date\" : null,\n");
+    writer.write("\t\t\t\"future_end_date\" : null\n");
+  }
+  else {
+    writer.write("\t\t\t\"future_max_rate\" : ");
+    writer.write_rate(future_max_rate);
+    writer.write(",\n\t\t\t\"future_min_rate\" : ");
+    writer.write_rate(element.get_future_min_rate());
+    writer.write(",\n\t\t\t\"future_effective_date\" : \"");
+    writer.write_date(element.get_future_effective_date());
+    writer.write("\",\n");
+    time_t epoch_future_end_date = element.get_future_end_date();
+    if (epoch_future_end_date <= 0)
+      writer.write("\t\t\t\"future_end_date\" : null\n");
     else {
-      convert_date(epoch_end_date, end_date);
-      json += "\t\t\t\"end_date\" : \"" + end_date + "\"\n";
-    }
-    if (future_max_rate <= 0) {
-      json += "\t\t\t\"future_max_rate\" : null,\n";
-      json += "\t\t\t\"future_min_rate\" : null,\n";
-      json += "\t\t\t\"future_effective_date\" : null,\n";
-      json += "\t\t\t\"future_end_date\" : null\n";
+      writer.write("\t\t\t\"future_end_date\" : \"");
+      writer.write_date(epoch_future_end_date);
+      writer.write("\"\n");
     }
+  }
+  writer.write("\t\t}");
+}
+
+void SearchResult::write_text_row(ResultWriter &writer, SearchResultElement &element, size_t) const {
+  unsigned long long code = element.get_code();
+  if (code != 0) {
+    writer.write("code                  : ");
+    writer.write_number(code);
+    writer.write("\n");
+  }
+  writer.write("code_name             : ");
+  writer.write(get_code_name(element.get_code_name_id()));
+  writer.write("\nrate_type             : ");
+  writer.write(trie::rate_type_to_string(element.get_rate_type()));
+  writer.write("\nrate_table_id         : ");
+  writer.write_number(element.get_rate_table_id());
+  writer.write("\negress_trunk_id       : ");
+  writer.write_number(element.get_egress_trunk_id());
+  writer.write("\ncurrent_max_rate      : ");
+  writer.write_rate(element.get_current_max_rate());
+  writer.write("\ncurrent_min_rate      : ");
+  writer.write_rate(element.get_current_min_rate());
+  writer.write("\neffective_date        : ");
+  writer.write_date(element.get_effective_date());
+  writer.write("\n");
+  time_t epoch_end_date = element.get_end_date();
+  if (epoch_end_date <= 0)
+    writer.write("end_date              : -\n");
+  else {
+    writer.write("end_date              : ");
+    writer.write_date(epoch_end_date);
+    writer.write("\n");
+  }
+  double future_max_rate = element.get_future_max_rate();
+  if (future_max_rate <= 0) {
+    writer.write("future_max_rate       : -\n");
+    writer.write("future_min_rate       : -\n");
+    writer.write("future_effective_date : -\n");
+    writer.write("future_end_date       : -\n");
+  }
+  else {
+    writer.write("future_max_rate       : ");
+    writer.write_rate(future_max_rate);
+    writer.write("\nfuture_min_rate       : ");
+    writer.write_rate(element.get_future_min_rate());
+    writer.write("\nfuture_effective_date : ");
+    writer.write_date(element.get_future_effective_date());
+    writer.write("\n");
+    time_t epoch_future_end_date = element.get_future_end_date();
+    if (epoch_future_end_date <= 0)
+      writer.write("future_end_date       : -\n");
     else {
-      double future_min_rate = (*it)->get_future_min_rate();
-      time_t epoch_future_effective_date = (*it)->get_future_effective_date();
-      time_t epoch_future_end_date = (*it)->get_future_end_date();
-      std::string future_effective_date;
-      std::string future_end_date;
-      convert_date(epoch_future_effective_date, future_effective_date);
-      json += "\t\t\t\"future_max_rate\" : " + std::to_string(future_max_rate) + ",\n";
-      json += "\t\t\t\"future_min_rate\" : " + std::to_string(future_min_rate)  + ",\n";
-      json += "\t\t\t\"future_effective_date\" : \"" + future_effective_date + "\",\n";
-      if (epoch_future_end_date <= 0)
-        json += "\t\t\t\"future_end_date\" : null\n";
-      else {
-        convert_date(epoch_future_end_date, future_end_date);
-        json += "\t\t\t\"future_end_date\" : \"" + future_end_date + "\"\n";
-      }
+      writer.write("future_end_date       : ");
+      writer.write_date(epoch_future_end_date);
+      writer.write("\n");
     }
-    json += "\t\t}";
   }
-  json += "\n\t]\n}\n";
+  writer.write("\n");
+}
+
+std::string SearchResult::to_json(bool sumarize_rate_table) {
+  rows_t rows;
+  select_rows(sumarize_rate_table, rows);
+  std::string json = "{  \"rank\" : [\n";
+  write_rows(rows, JSON_ROW_SIZE,
+    [this](ResultWriter &writer, SearchResultElement &element, size_t row) { write_json_row(writer, element, row); },
+    json);
+  write_json_end(json);
   return json;
 }
 
+void SearchResult::write_json_end(std::string &json) const {
+  json += "\n\t]";
+  if (more_rows)
+    json += ",\n  \"next_cursor\" : \"" + get_next_cursor() + "\"";
+  json += "\n}\n";
+}
+
+/**
+    Starts writing the JSON of the result a few rows at a time, the same text to_json returns:
+    appends its head to the output
+*/
+void SearchResult::open_json(std::string &output, bool sumarize_rate_table) {
+  stream_rows.clear();
+  select_rows(sumarize_rate_table, stream_rows);
+  stream_row = 0;
+  output += "{  \"rank\" : [\n";
+}
+
+/**
+    Appends the next rows, at most the given count, and the end of the JSON after the last ones.
+    Returns false once the end is written.
+*/
+bool SearchResult::write_json(std::string &output, size_t rows_count) {
+  size_t rows_end = std::min(stream_rows.size(), stream_row + rows_count);
+  ResultWriter writer(output);
+  for (; stream_row < rows_end; ++stream_row)
+    write_json_row(writer, *stream_rows[stream_row], stream_row);
+  if (stream_row < stream_rows.size())
+    return true;
+  write_json_end(output);
+  rows_t().swap(stream_rows);
+  return false;
+}
+
 std::string SearchResult::to_text_table(bool sumarize_rate_table) {
-  std::set<unsigned int> rate_table_ids;
+  rows_t rows;
+  select_rows(sumarize_rate_table, rows);
   std::string table = "";
-  for (auto it = data->begin(); it != data->end(); ++it) {
-    unsigned int rate_table_id = (*it)->get_rate_table_id();
-    if (sumarize_rate_table) {
-      if (rate_table_ids.find(rate_table_id) !=  rate_table_ids.end())
-        continue;
-      rate_table_ids.insert(rate_table_id);
-    }
-    time_t epoch_effective_date = (*it)->get_effective_date();
-    time_t epoch_end_date = (*it)->get_end_date();
-    std::string effective_date;
-    std::string end_date;
-    convert_date(epoch_effective_date, effective_date);
-    double future_max_rate = (*it)->get_future_max_rate();
-    unsigned long long code = (*it)->get_code();
-    if (code != 0)
-      table += "code                  : " + std::to_string((*it)->get_code()) + "\n";
-    table += "code_name             : " + (*it)->get_code_name() + "\n";
-    table += "rate_type             : " + trie::rate_type_to_string((*it)->get_rate_type()) + "\n";
-    table += "rate_table_id         : " + std::to_string((*it)->get_rate_table_id()) + "\n";
-    table += "egress_trunk_id       : " + std::to_string((*it)->get_egress_trunk_id()) + "\n";
-    table += "current_max_rate      : " + std::to_string((*it)->get_current_max_rate()) + "\n";
-    table += "current_min_rate      : " + std::to_string((*it)->get_current_min_rate()) + "\n";
-    table += "effective_date        : " + effective_date + "\n";
-    if (epoch_end_date <= 0)
-      table += "end_date              : -\n";
-    else {
-      convert_date(epoch_end_date, end_date);
-      table += "end_date              : " + end_date + "\n";
-    }
-    if (future_max_rate <= 0) {
-      table += "future_max_rate       : -\n";
-      table += "future_min_rate       : -\n";
-      table += "future_effective_date : -\n";
-      table += "future_end_date       : -\n";
-    }
-    else {
-      double future_min_rate = (*it)->get_future_min_rate();
-      time_t epoch_future_effective_date = (*it)->get_future_effective_date();
-      time_t epoch_future_end_date = (*it)->get_future_end_date();
-      std::string future_effective_date;
-      std::string future_end_date;
-      convert_date(epoch_future_effective_date, future_effective_date);
-      table += "future_max_rate       : " + std::to_string(future_max_rate) + "\n";
-      table += "future_min_rate       : " + std::to_string(future_min_rate)  + "\n";
-      table += "future_effective_date : " + future_effective_date + "\n";
-      if (epoch_future_end_date <= 0)
-        table += "future_end_date       : -\n";
-      else {
-        convert_date(epoch_future_end_date, future_end_date);
-        table += "future_end_date       : " + future_end_date + "\n";
-      }
-    }
-    table += "\n";
-  }
+  write_rows(rows, TEXT_ROW_SIZE,
+    [this](ResultWriter &writer, SearchResultElement &element, size_t row) { write_text_row(writer, element, row); },
+    table);
+  if (more_rows)
+    table += "next_cursor           : " + get_next_cursor() + "\n";
   return table;
 }
 
-size_t SearchResult::size() const {
-  return data->size();
+/**
+    Same rows as to_json, for programs: every integer is little-endian, every rate an IEEE 754
+    double stored as a little-endian 64 bits integer.
+
+      uint32  length of the rest of the message
+      char[4] "LPSR"
+      uint16  format version, 1
+      uint16  record size, 88
+      uint32  records count
+      uint32  code names count
+      uint16  next cursor length, 0 on the last page
+      uint16  0
+      char[]  next cursor
+    Then each code name of the records, once:
+      uint32  code name id
+      uint16  name length
+      char[]  name
+    Then each record, one per row, in rank order:
+      0  uint64 code, 0 unless the codes found are included
+      8  uint32 code name id
+      12 uint32 rate table id
+      16 uint32 egress trunk id
+      20 uint8  rate type: 0 default, 1 inter, 2 intra, 3 local, then 3 zero bytes
+      24 double current max rate
+      32 double current min rate
+      40 double future max rate, none if not above 0
+      48 double future min rate
+      56 int64  effective date, epoch seconds, none if not above 0
+      64 int64  end date, same
+      72 int64  future effective date, same
+      80 int64  future end date, same
+*/
+std::string SearchResult::to_binary(bool sumarize_rate_table) {
+  rows_t rows;
+  select_rows(sumarize_rate_table, rows);
+  std::string next_cursor = get_next_cursor();
+  std::vector<uint32_t> code_name_ids;
+  for (auto it = rows.begin(); it != rows.end(); ++it)
+    code_name_ids.push_back((*it)->get_code_name_id());
+  std::sort(code_name_ids.begin(), code_name_ids.end());
+  code_name_ids.erase(std::unique(code_name_ids.begin(), code_name_ids.end()), code_name_ids.end());
+  std::string binary;
+  ResultWriter writer(binary);
+  writer.write_binary(0, 4);
+  writer.write("LPSR");
+  writer.write_binary(1, 2);
+  writer.write_binary(BINARY_ROW_SIZE, 2);
+  writer.write_binary(rows.size(), 4);
+  writer.write_binary(code_name_ids.size(), 4);
+  writer.write_binary(next_cursor.size(), 2);
+  writer.write_binary(0, 2);
+  writer.write(next_cursor);
+  for (auto it = code_name_ids.begin(); it != code_name_ids.end(); ++it) {
+    const std::string &code_name = get_code_name(*it);
+    writer.write_binary(*it, 4);
+    writer.write_binary(code_name.size(), 2);
+    writer.write(code_name);
+  }
+  write_rows(rows, BINARY_ROW_SIZE,
+    [this](ResultWriter &writer, SearchResultElement &element, size_t row) { write_binary_row(writer, element, row); },
+    binary);
+  uint32_t length = binary.size() - 4;
+  for (size_t i = 0; i < 4; ++i, length >>= 8)
+    binary[i] = (char)(length & 0xff);
+  return binary;
+}
+
+void SearchResult::write_binary_row(ResultWriter &writer, SearchResultElement &element, size_t) const {
+  writer.write_binary(element.get_code(), 8);
+  writer.write_binary(element.get_code_name_id(), 4);
+  writer.write_binary(element.get_rate_table_id(), 4);
+  writer.write_binary(element.get_egress_trunk_id(), 4);
+  writer.write_binary(element.get_rate_type(), 4);
+  writer.write_binary_rate(element.get_current_max_rate());
+  writer.write_binary_rate(element.get_current_min_rate());
+  writer.write_binary_rate(element.get_future_max_rate());
+  writer.write_binary_rate(element.get_future_min_rate());
+  writer.write_binary(element.get_effective_date(), 8);
+  writer.write_binary(element.get_end_date(), 8);
+  writer.write_binary(element.get_future_effective_date(), 8);
+  writer.write_binary(element.get_future_end_date(), 8);
+}
+
+size_t SearchResult::size() {
+  merge();
+  return data.size();
 }
@@ -2,15 +2,20 @@
 #define SEARCH_RESULT_HXX
 
 #include "shared.hxx"
+#include "code_names.hxx"
+#include "arena.hxx"
+#include "result_writer.hxx"
 #include <tbb/tbb.h>
-#include <set>
+#include <vector>
+#include <unordered_map>
+#include <functional>
 
 namespace search {
 
   class SearchResultElement {
     private:
       unsigned long long code;
-      std::string code_name;
+      uint32_t code_name_id;
       unsigned long long rate_table_id;
       trie::rate_type_t rate_type;
       double current_min_rate;
@@ -24,7 +29,7 @@ namespace search {
       unsigned int egress_trunk_id;
     public:
       SearchResultElement(unsigned long long code,
-                          std::string code_name,
+                          uint32_t code_name_id,
                           unsigned long long rate_table_id,
                           trie::rate_type_t rate_type,
                           double current_min_rate,
@@ -36,9 +41,9 @@ namespace search {
                           time_t future_effective_date,
                           time_t future_end_date,
                           unsigned int egress_trunk_id);
-      bool operator >(SearchResultElement &other) const ;
+      bool operator >(const SearchResultElement &other) const;
       unsigned long long get_code();
-      std::string get_code_name();
+      uint32_t get_code_name_id();
       unsigned long long get_rate_table_id();
       trie::rate_type_t get_rate_type();
       double get_current_min_rate();
@@ -53,22 +58,135 @@ namespace search {
   };
 
   typedef struct {
-    bool operator ()(SearchResultElement* a, SearchResultElement* b) { return *a > *b; };
+    bool operator ()(const SearchResultElement &a, const SearchResultElement &b) const { return a > b; };
   } compare_elements_t;
 
+  /** Arguments of an insertion into a search result, as found by the search */
+  typedef struct {
+    unsigned long long code;
+    uint32_t code_name_id;
+    unsigned long long rate_table_id;
+    trie::rate_type_t rate_type;
+    double current_min_rate;
+    double current_max_rate;
+    double future_min_rate;
+    double future_max_rate;
+    time_t effective_date;
+    time_t end_date;
+    time_t future_effective_date;
+    time_t future_end_date;
+    time_t reference_time;
+    unsigned int egress_trunk_id;
+  } search_match_t;
+  typedef std::vector<search_match_t> search_matches_t;
+  typedef search_matches_t* p_search_matches_t;
+
+  /**
+      Ranking of the matches: by current max rate, code and rate table id, the rank of their
+      elements, then by their other fields, so the one kept out of several matches of equal rank
+      doesn't depend on the order they were inserted in
+  */
+  bool ranks_before(const search_match_t &a, const search_match_t &b);
+  bool same_rank(const search_match_t &a, const search_match_t &b);
+
+  /**
+      Allocator of the match buffers: from the arena given, shared by the results of a task, or
+      else from the TBB scalable allocator, whose thread caches hand the memory of the previous
+      searches to the next ones instead of mapping and unmapping memory for each result
+  */
+  template<typename T>
+  class MatchAllocator {
+    public:
+      typedef T value_type;
+      typedef T* pointer;
+      typedef const T* const_pointer;
+      typedef T& reference;
+      typedef const T& const_reference;
+      typedef size_t size_type;
+      typedef ptrdiff_t difference_type;
+      template<typename U> struct rebind { typedef MatchAllocator<U> other; };
+      ctrl::p_arena_t arena;
+      MatchAllocator(ctrl::p_arena_t arena = nullptr) : arena(arena) {}
+      template<typename U> MatchAllocator(const MatchAllocator<U> &other) : arena(other.arena) {}
+      pointer allocate(size_type count, const void* = 0) {
+        if (arena)
+          return static_cast<pointer>(arena->allocate(count * sizeof(T)));
+        return tbb::scalable_allocator<T>().allocate(count);
+      }
+      void deallocate(pointer p, size_type count) {
+        if (!arena)
+          tbb::scalable_allocator<T>().deallocate(p, count);
+      }
+      size_type max_size() const { return SIZE_MAX / sizeof(T); }
+      template<typename U, typename... Args> void construct(U *p, Args&&... args) { ::new((void*)p) U(std::forward<Args>(args)...); }
+      template<typename U> void destroy(U *p) { p->~U(); }
+  };
+
+  template<typename T, typename U>
+  bool operator==(const MatchAllocator<T> &a, const MatchAllocator<U> &b) { return a.arena == b.arena; }
+  template<typename T, typename U>
+  bool operator!=(const MatchAllocator<T> &a, const MatchAllocator<U> &b) { return a.arena != b.arena; }
+
+  class SearchResult;
+  typedef SearchResult* p_search_result_t;
+
+  /** Media type of to_binary, for HTTP negotiation */
+  const char BINARY_CONTENT_TYPE[] = "application/vnd.lps-result";
+
+  /**
+      Insertions only append the match to a buffer of the inserting thread, allocated from the
+      thread caches of the scalable allocator or from a shared arena: searches insert from many
+      tasks at once without sharing a lock. The buffered matches are merged into the ranking, sorted in parallel, by the first
+      call reading the result, and a match equal in rank to one already there is dropped.
+      Elements keep the id of their code name: the names are copied by resolve_code_names, once
+      per code name, before the generation of the searched tables may be released.
+      A result limited to a page keeps, out of each buffer, only the matches that may show up in
+      the first offset + limit + 1 rows once summarized as asked, so its memory and merge cost are
+      bounded by the page instead of the whole ranking. Its cursor names the generation searched:
+      a page asked with a cursor of another generation is stale and searches nothing.
+      Rows are serialized through a ResultWriter, those of large results in parallel chunks, or
+      streamed a few at a time by open_json and write_json.
+  */
   class SearchResult {
     private:
-      typedef std::set<SearchResultElement*, compare_elements_t> search_result_elements_t;
-      typedef search_result_elements_t* p_search_result_elements_t;
+      typedef std::vector<search_match_t, MatchAllocator<search_match_t>> match_buffer_t;
+      typedef tbb::enumerable_thread_specific<match_buffer_t> match_buffers_t;
+      typedef std::vector<SearchResultElement> search_result_elements_t;
+      typedef std::unordered_map<uint32_t, std::string> code_names_t;
+      typedef std::vector<SearchResultElement*> rows_t;
+      typedef std::function<void(ResultWriter&, SearchResultElement&, size_t)> write_row_t;
+      static const size_t ROWS_PER_CHUNK = 2048;
+      static const size_t JSON_ROW_SIZE = 512;
+      static const size_t TEXT_ROW_SIZE = 512;
+      static const size_t BINARY_ROW_SIZE = 88;
       unsigned int days_ahead;
-      tbb::mutex search_insertion_mutex;
-      p_search_result_elements_t data;
-      void convert_date(time_t epoch_date, std::string &readable_date);
+      size_t page_offset;
+      size_t page_limit;
+      bool page_sumarize_rate_table;
+      unsigned long long generation_id;
+      bool stale;
+      bool more_rows;
+      rows_t stream_rows;
+      size_t stream_row;
+      match_buffers_t match_buffers;
+      search_result_elements_t data;
+      code_names_t code_names;
+      SearchResultElement to_element(const search_match_t &match) const;
+      size_t kept_rows_count() const;
+      search_match_t *keep_ranked(search_match_t *begin, search_match_t *end, bool in_parallel) const;
+      void merge();
+      bool in_page(size_t row);
+      void select_rows(bool sumarize_rate_table, rows_t &rows);
+      void write_rows(const rows_t &rows, size_t row_size, const write_row_t &write_row, std::string &output) const;
+      void write_json_row(ResultWriter &writer, SearchResultElement &element, size_t row) const;
+      void write_text_row(ResultWriter &writer, SearchResultElement &element, size_t row) const;
+      void write_json_end(std::string &json) const;
+      void write_binary_row(ResultWriter &writer, SearchResultElement &element, size_t row) const;
+      const std::string &get_code_name(uint32_t code_name_id) const;
     public:
-      SearchResult(unsigned int days_ahead = 7);
-      ~SearchResult();
+      SearchResult(unsigned int days_ahead = 7, ctrl::p_arena_t shared_arena = nullptr);
       void insert(unsigned long long code,
-                  std::string code_name,
+                  uint32_t code_name_id,
                   unsigned long long rate_table_id,
                   trie::rate_type_t rate_type,
                   double current_min_rate,
@@ -81,9 +199,19 @@ namespace search {
                   time_t future_end_date,
                   time_t reference_time,
                   unsigned int egress_trunk_id);
-      size_t size() const;
+      bool set_page(size_t offset, size_t limit, bool sumarize_rate_table = true);
+      bool set_cursor(const std::string &cursor);
+      bool pin_generation(unsigned long long searched_generation_id);
+      bool is_stale() const;
+      std::string get_next_cursor() const;
+      void take_matches(search_matches_t &matches);
+      void resolve_code_names(const ctrl::CodeNames &generation_code_names);
+      size_t size();
       std::string to_json(bool sumarize_rate_table = true);
+      void open_json(std::string &output, bool sumarize_rate_table = true);
+      bool write_json(std::string &output, size_t rows_count);
       std::string to_text_table(bool sumarize_rate_table = true);
+      std::string to_binary(bool sumarize_rate_table = true);
   };
 
 }
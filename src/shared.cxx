@@ -27,6 +27,33 @@ std::string trie::rate_type_to_string(rate_type_t rate_type) {
     throw RestRequestArgException();
 }
 
+/**
+    Creates an empty code set and its code value in the given arena
+*/
+ctrl::p_code_value_t ctrl::create_code_value(p_arena_t arena, unsigned int worker_index) {
+  p_code_set_t code_set = arena->create<code_set_t>(8, tbb::tbb_hash<unsigned long long>(), std::equal_to<unsigned long long>(), ArenaAllocator<unsigned long long>(arena));
+  return arena->create<code_value_t>(worker_index, code_set);
+}
+
 void ctrl::str_to_upper(std::string &str) {
   std::transform(str.begin(), str.end(),str.begin(), ::toupper);
 }
+
+/**
+    Parses "code[,rate_type[,days_ahead]]", the rate type being default and the days ahead 7 if missing
+*/
+ctrl::code_query_t ctrl::parse_code_query(const std::string &text) {
+  code_query_t code_query;
+  size_t rate_type_pos = text.find(',');
+  size_t days_ahead_pos = rate_type_pos == std::string::npos ? std::string::npos : text.find(',', rate_type_pos + 1);
+  std::string arg_code = text.substr(0, rate_type_pos);
+  std::string arg_rate_type = rate_type_pos == std::string::npos ? "" : text.substr(rate_type_pos + 1, days_ahead_pos - rate_type_pos - 1);
+  std::string arg_days_ahead = days_ahead_pos == std::string::npos ? "" : text.substr(days_ahead_pos + 1);
+  if (arg_code.empty() || arg_code.find_first_not_of("0123456789") != std::string::npos ||
+      arg_days_ahead.find_first_not_of("0123456789") != std::string::npos)
+    throw RestRequestArgException();
+  code_query.code = std::stoull(arg_code);
+  code_query.rate_type = trie::to_rate_type_t(arg_rate_type);
+  code_query.days_ahead = arg_days_ahead == "" ? 7 : std::stoul(arg_days_ahead);
+  return code_query;
+}
@@ -1,22 +1,37 @@
 #ifndef SHARED_HXX
 #define SHARED_HXX
 
+#include "arena.hxx"
 #include <tbb/tbb.h>
-#include <set>
+#include <string>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <cstdint>
 
 namespace ctrl {
 
-  typedef struct {
-    bool operator ()(const unsigned long long &a, const unsigned long long &b) const { return a > b; };
-  } compare_codes_t;
-
-  typedef std::set<unsigned long long, compare_codes_t> code_set_t;
+  /** Code sets are allocated from the arena of their generation, as well as their code values */
+  typedef tbb::concurrent_unordered_set<unsigned long long, tbb::tbb_hash<unsigned long long>, std::equal_to<unsigned long long>, ArenaAllocator<unsigned long long>> code_set_t;
   typedef code_set_t* p_code_set_t;
-  typedef std::pair<unsigned int, p_code_set_t> code_value_t;
+  const uint32_t NO_CODE_NAME_ID = UINT32_MAX;
+  /**
+      Code name id is only assigned (by CodeNames) once the load of the code name is over. A delta
+      load assigns the ids of its new code names on code values shared with the published
+      generation, whose searches read them meanwhile: the id is atomic, stored with release.
+  */
+  typedef struct code_value_t {
+    unsigned int worker_index;
+    std::atomic<uint32_t> code_name_id;
+    p_code_set_t code_set;
+    code_value_t(unsigned int worker_index, p_code_set_t code_set)
+      : worker_index(worker_index), code_name_id(NO_CODE_NAME_ID), code_set(code_set) {}
+  } code_value_t;
   typedef code_value_t* p_code_value_t;
   typedef std::pair<const std::string, p_code_value_t> code_pair_t;
   typedef code_pair_t* p_code_pair_t;
 
+  p_code_value_t create_code_value(p_arena_t arena, unsigned int worker_index);
   void str_to_upper(std::string &str);
 }
 
@@ -27,9 +42,25 @@ namespace trie {
     RATE_TYPE_INTRA,
     RATE_TYPE_LOCAL
   };
+  const unsigned char RATE_TYPES_COUNT = RATE_TYPE_LOCAL + 1;
 
   rate_type_t to_rate_type_t(std::string rate_type);
   std::string rate_type_to_string(rate_type_t rate_type);
 }
 
+namespace ctrl {
+
+  /** One code of a batch lookup, searched with its own rate type into a result of its own days ahead */
+  typedef struct {
+    unsigned long long code;
+    trie::rate_type_t rate_type;
+    unsigned int days_ahead;
+  } code_query_t;
+  typedef std::vector<code_query_t> code_queries_t;
+  /** Most codes a batch lookup may ask, each of them holding a result and its text until answered */
+  const size_t MAX_CODE_QUERIES = 1000;
+
+  code_query_t parse_code_query(const std::string &text);
+}
+
 #endif
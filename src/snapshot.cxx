@@ -0,0 +1,116 @@
+#include "snapshot.hxx"
+#include "exceptions.hxx"
+#include <vector>
+#include <cstring>
+#include <cstdio>
+
+using namespace ctrl;
+
+const char Snapshot::MAGIC[8] = {'L', 'P', 'S', 'S', 'N', 'A', 'P', '\0'};
+
+/**
+    Writes the tables in their frozen vector order, which is also the order of their index positions
+*/
+void Snapshot::write_tables(SnapshotWriter &writer, p_frozen_tables_t frozen_tables) {
+  writer.write_value<uint64_t>(frozen_tables->size());
+  for (size_t i = 0; i < frozen_tables->size(); ++i)
+    (*frozen_tables)[i]->write_to(writer);
+}
+
+void Snapshot::read_tables(SnapshotReader &reader, p_frozen_tables_t frozen_tables, p_tables_index_t tables_index, uint32_t code_names_count) {
+  uint64_t tables_count = reader.read_value<uint64_t>();
+  for (uint64_t i = 0; i < tables_count; ++i) {
+    trie::p_frozen_trie_t frozen_trie = new trie::FrozenTrie(reader, code_names_count);
+    frozen_tables->push_back(frozen_trie);
+    if (!tables_index->insert(std::make_pair(frozen_trie->get_rate_table_id(), (size_t)i)).second)
+      throw SnapshotInvalidException();
+  }
+}
+
+/**
+    Writes the snapshot to a temporary file renamed over the given path once complete, so the
+    previous snapshot stays usable until the new one is fully on disk
+*/
+void Snapshot::save(const std::string &path, time_t reference_time, unsigned int last_rate_id, p_code_names_t code_names,
+                    p_frozen_tables_t world_tables, p_frozen_tables_t us_tables, p_frozen_tables_t az_tables) {
+  std::string temporary_path = path + ".tmp";
+  try {
+    SnapshotWriter writer(temporary_path, sizeof(header_t));
+    std::vector<unsigned long long> code_set;
+    writer.write_value<uint64_t>(code_names->size());
+    for (uint32_t code_name_id = 0; code_name_id < code_names->size(); ++code_name_id) {
+      writer.write_string(code_names->get_code_name(code_name_id));
+      code_set.assign(code_names->codes_begin(code_name_id), code_names->codes_end(code_name_id));
+      writer.write_vector(code_set);
+    }
+    write_tables(writer, world_tables);
+    write_tables(writer, us_tables);
+    write_tables(writer, az_tables);
+    header_t header = header_t();
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.last_rate_id = last_rate_id;
+    header.reference_time = reference_time;
+    header.payload_size = writer.get_payload_size();
+    header.checksum = writer.get_checksum();
+    writer.finish(&header);
+  }
+  catch (...) {
+    std::remove(temporary_path.c_str());
+    throw;
+  }
+  if (std::rename(temporary_path.c_str(), path.c_str()) != 0)
+    throw SnapshotIOException();
+}
+
+/**
+    Reads a snapshot into a new generation, with its code names keeping their ids and its code
+    sets allocated in the given arenas, which the generation owns from then on (it is deleted
+    along with them if the file is invalid).
+    Jump tables, unified indices and multibit nodes are left to the caller.
+*/
+p_generation_t Snapshot::load(const std::string &path, p_arenas_t codes_arenas, unsigned int &last_rate_id) {
+  p_generation_t generation = new Generation(0);
+  generation->codes_arenas = codes_arenas;
+  try {
+    SnapshotReader reader(path);
+    header_t header;
+    reader.read(&header, sizeof(header_t));
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+        !reader.verify(sizeof(header_t), header.payload_size, header.checksum))
+      throw SnapshotInvalidException();
+    generation->reference_time = header.reference_time;
+    last_rate_id = header.last_rate_id;
+    generation->codes = new codes_t();
+    generation->code_names = new CodeNames();
+    uint64_t codes_count = reader.read_value<uint64_t>();
+    if (codes_count >= NO_CODE_NAME_ID)
+      throw SnapshotInvalidException();
+    std::vector<unsigned long long> code_set;
+    for (uint64_t i = 0; i < codes_count; ++i) {
+      std::string code_name = reader.read_string();
+      reader.read_vector(code_set);
+      p_code_value_t code_value = create_code_value((*codes_arenas)[0], 0);
+      code_value->code_set->insert(code_set.begin(), code_set.end());
+      std::pair<codes_t::iterator, bool> inserted = generation->codes->insert(std::make_pair(code_name, code_value));
+      if (!inserted.second)
+        throw SnapshotInvalidException();
+      generation->code_names->intern(&(*inserted.first));
+    }
+    generation->code_names->freeze();
+    generation->world_tables_tries = new frozen_tables_t();
+    generation->world_tables_index = new tables_index_t();
+    generation->us_tables_tries = new frozen_tables_t();
+    generation->us_tables_index = new tables_index_t();
+    generation->az_tables_tries = new frozen_tables_t();
+    generation->az_tables_index = new tables_index_t();
+    read_tables(reader, generation->world_tables_tries, generation->world_tables_index, generation->code_names->size());
+    read_tables(reader, generation->us_tables_tries, generation->us_tables_index, generation->code_names->size());
+    read_tables(reader, generation->az_tables_tries, generation->az_tables_index, generation->code_names->size());
+  }
+  catch (...) {
+    delete generation;
+    throw;
+  }
+  return generation;
+}
@@ -0,0 +1,44 @@
+/**
+      Snapshot file of a generation, read back on startup to serve queries before the first load
+*/
+#ifndef SNAPSHOT_HXX
+#define SNAPSHOT_HXX
+
+#include "generation.hxx"
+#include "snapshot_file.hxx"
+#include <string>
+#include <cstdint>
+#include <time.h>
+
+namespace ctrl {
+
+  class Snapshot;
+
+  /**
+      The file starts with a fixed header (magic, format version, reference time, last rate_id
+      loaded, payload size and checksum), followed by the code names (in id order) with their code
+      sets and the one digit prefix trees of each partition. There are no pointers in the file: nodes refer to
+      each other by offset and rate records refer to their code name by id. Jump tables, unified
+      indices and multibit nodes are not stored, they are rebuilt after loading.
+  */
+  class Snapshot {
+    private:
+      typedef struct {
+        char magic[8];
+        uint32_t version;
+        uint32_t last_rate_id;
+        int64_t reference_time;
+        uint64_t payload_size;
+        uint64_t checksum;
+      } header_t;
+      static const char MAGIC[8];
+      static const uint32_t VERSION = 2;
+      static void write_tables(SnapshotWriter &writer, p_frozen_tables_t frozen_tables);
+      static void read_tables(SnapshotReader &reader, p_frozen_tables_t frozen_tables, p_tables_index_t tables_index, uint32_t code_names_count);
+    public:
+      static void save(const std::string &path, time_t reference_time, unsigned int last_rate_id, p_code_names_t code_names,
+                       p_frozen_tables_t world_tables, p_frozen_tables_t us_tables, p_frozen_tables_t az_tables);
+      static p_generation_t load(const std::string &path, p_arenas_t codes_arenas, unsigned int &last_rate_id);
+  };
+}
+#endif
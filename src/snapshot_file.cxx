@@ -0,0 +1,147 @@
+#include "snapshot_file.hxx"
+#include "exceptions.hxx"
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace ctrl;
+
+uint64_t ctrl::update_snapshot_checksum(uint64_t checksum, const char *data, size_t size) {
+  const uint64_t prime = 0x100000001b3ULL;
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, data + i, sizeof(uint64_t));
+    checksum = (checksum ^ word) * prime;
+    checksum ^= checksum >> 29;
+  }
+  for (; i < size; ++i)
+    checksum = (checksum ^ (unsigned char)data[i]) * prime;
+  return checksum;
+}
+
+SnapshotWriter::SnapshotWriter(const std::string &path, size_t header_size)
+  : header_size(header_size), payload_size(0), checksum(SNAPSHOT_CHECKSUM_SEED)
+{
+  file = fopen(path.c_str(), "wb");
+  if (!file)
+    throw SnapshotIOException();
+  buffer.reserve(BUFFER_SIZE);
+  std::vector<char> header(header_size, 0);
+  if (fwrite(header.data(), 1, header_size, file) != header_size) {
+    fclose(file);
+    throw SnapshotIOException();
+  }
+}
+
+SnapshotWriter::~SnapshotWriter() {
+  if (file)
+    fclose(file);
+}
+
+/**
+    Checksums and writes the buffered payload. Only the last flush may be shorter than BUFFER_SIZE.
+*/
+void SnapshotWriter::flush() {
+  checksum = update_snapshot_checksum(checksum, buffer.data(), buffer.size());
+  if (fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size())
+    throw SnapshotIOException();
+  buffer.clear();
+}
+
+void SnapshotWriter::write(const void *data, size_t size) {
+  const char *bytes = static_cast<const char*>(data);
+  payload_size += size;
+  while (size > 0) {
+    size_t chunk_size = BUFFER_SIZE - buffer.size() < size ? BUFFER_SIZE - buffer.size() : size;
+    buffer.insert(buffer.end(), bytes, bytes + chunk_size);
+    bytes += chunk_size;
+    size -= chunk_size;
+    if (buffer.size() == BUFFER_SIZE)
+      flush();
+  }
+}
+
+void SnapshotWriter::write_string(const std::string &value) {
+  write_value<uint64_t>(value.size());
+  write(value.data(), value.size());
+}
+
+uint64_t SnapshotWriter::get_payload_size() const {
+  return payload_size;
+}
+
+uint64_t SnapshotWriter::get_checksum() const {
+  return update_snapshot_checksum(checksum, buffer.data(), buffer.size());
+}
+
+/**
+    Flushes the payload, writes the header in the reserved space and syncs the file to disk
+*/
+void SnapshotWriter::finish(const void *header) {
+  flush();
+  if (fseek(file, 0, SEEK_SET) != 0 || fwrite(header, 1, header_size, file) != header_size ||
+      fflush(file) != 0 || fsync(fileno(file)) != 0)
+    throw SnapshotIOException();
+  if (fclose(file) != 0) {
+    file = nullptr;
+    throw SnapshotIOException();
+  }
+  file = nullptr;
+}
+
+SnapshotReader::SnapshotReader(const std::string &path) : data(nullptr), size(0), position(0) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw SnapshotIOException();
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+    close(fd);
+    throw SnapshotIOException();
+  }
+  size = file_stat.st_size;
+  void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+    throw SnapshotIOException();
+  madvise(mapping, size, MADV_SEQUENTIAL);
+  data = static_cast<const char*>(mapping);
+}
+
+SnapshotReader::~SnapshotReader() {
+  munmap(const_cast<char*>(data), size);
+}
+
+void SnapshotReader::read(void *value, size_t value_size) {
+  if (value_size > size - position)
+    throw SnapshotInvalidException();
+  memcpy(value, data + position, value_size);
+  position += value_size;
+}
+
+std::string SnapshotReader::read_string() {
+  uint64_t length = read_value<uint64_t>();
+  check_remaining(length, 1);
+  std::string value(data + position, length);
+  position += length;
+  return value;
+}
+
+/**
+    Throws unless count values of the given size are left to read
+*/
+void SnapshotReader::check_remaining(uint64_t count, size_t value_size) const {
+  if (count > (size - position) / value_size)
+    throw SnapshotInvalidException();
+}
+
+/**
+    Whether the file holds exactly the payload described by the header, with a matching checksum
+*/
+bool SnapshotReader::verify(size_t header_size, uint64_t payload_size, uint64_t checksum) const {
+  if (size < header_size || size - header_size != payload_size)
+    return false;
+  return update_snapshot_checksum(SNAPSHOT_CHECKSUM_SEED, data + header_size, payload_size) == checksum;
+}
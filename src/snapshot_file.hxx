@@ -0,0 +1,84 @@
+/**
+      Buffered, checksummed writing of a snapshot file, and reading it back from a read-only mapping
+*/
+#ifndef SNAPSHOT_FILE_HXX
+#define SNAPSHOT_FILE_HXX
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+
+namespace ctrl {
+
+  class SnapshotWriter;
+  class SnapshotReader;
+
+  /**
+      Checksum of the payload of a snapshot: a multiplicative hash of each 8 bytes word, then of
+      the trailing bytes. Feeding the data in pieces gives the same result as long as every piece
+      but the last is a multiple of 8 bytes long.
+  */
+  uint64_t update_snapshot_checksum(uint64_t checksum, const char *data, size_t size);
+  const uint64_t SNAPSHOT_CHECKSUM_SEED = 0xcbf29ce484222325ULL;
+
+  /**
+      Writes the payload after a reserved header, which is filled in by finish once the payload
+      size and checksum are known. Values are written in the native layout of this build.
+  */
+  class SnapshotWriter {
+    private:
+      static const size_t BUFFER_SIZE = 1 << 20;
+      FILE *file;
+      size_t header_size;
+      std::vector<char> buffer;
+      uint64_t payload_size;
+      uint64_t checksum;
+      void flush();
+    public:
+      SnapshotWriter(const std::string &path, size_t header_size);
+      ~SnapshotWriter();
+      void write(const void *data, size_t size);
+      template<typename T> void write_value(const T &value) {
+        write(&value, sizeof(T));
+      }
+      template<typename T> void write_vector(const std::vector<T> &values) {
+        write_value<uint64_t>(values.size());
+        write(values.data(), values.size() * sizeof(T));
+      }
+      void write_string(const std::string &value);
+      uint64_t get_payload_size() const;
+      uint64_t get_checksum() const;
+      void finish(const void *header);
+  };
+
+  /**
+      Maps the whole file read-only. Reads past the end of the file throw SnapshotInvalidException.
+  */
+  class SnapshotReader {
+    private:
+      const char *data;
+      size_t size;
+      size_t position;
+    public:
+      SnapshotReader(const std::string &path);
+      ~SnapshotReader();
+      void read(void *value, size_t value_size);
+      template<typename T> T read_value() {
+        T value;
+        read(&value, sizeof(T));
+        return value;
+      }
+      template<typename T> void read_vector(std::vector<T> &values) {
+        uint64_t count = read_value<uint64_t>();
+        check_remaining(count, sizeof(T));
+        values.resize(count);
+        read(values.data(), count * sizeof(T));
+      }
+      std::string read_string();
+      void check_remaining(uint64_t count, size_t value_size) const;
+      bool verify(size_t header_size, uint64_t payload_size, uint64_t checksum) const;
+  };
+}
+#endif
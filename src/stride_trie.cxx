@@ -0,0 +1,113 @@
+#include "stride_trie.hxx"
+#include "frozen_trie.hxx"
+#include "digit_cursor.hxx"
+#include "exceptions.hxx"
+
+using namespace trie;
+
+/**
+    Expands the given frozen prefix tree into nodes of stride digits. Rate store stays owned by the frozen tree.
+*/
+StrideTrie::StrideTrie(const FrozenTrie &frozen_trie, unsigned char stride) : stride(stride) {
+  if (stride < 1 || stride > MAX_STRIDE)
+    throw TrieInvalidStrideException();
+  fanout = 1;
+  for (unsigned char i = 0; i < stride; ++i)
+    fanout *= 10;
+  rate_table_id = frozen_trie.get_rate_table_id();
+  rate_store = frozen_trie.get_rate_store();
+  expand_node(frozen_trie, 0);
+  stride_slot_t sentinel;
+  sentinel.child = NO_NODE;
+  sentinel.matches_pos = matches.size();
+  slots.push_back(sentinel);
+  slots.shrink_to_fit();
+  matches.shrink_to_fit();
+}
+
+/**
+    Appends the node for the given frozen node and the nodes of its descendants, returns the node offset.
+    All the matches of a node are appended before its children are expanded, so matches stay in slot order.
+*/
+uint32_t StrideTrie::expand_node(const FrozenTrie &frozen_trie, uint32_t frozen_node) {
+  uint32_t node_offset = slots.size() / fanout;
+  uint32_t slots_pos = slots.size();
+  slots.resize(slots_pos + fanout);
+  std::vector<uint32_t> frozen_children(fanout, FrozenTrie::NO_NODE);
+  for (uint32_t slot = 0; slot < fanout; ++slot) {
+    slots[slots_pos + slot].matches_pos = matches.size();
+    uint32_t current_node = frozen_node;
+    uint32_t power10 = fanout;
+    for (unsigned char length = 1; length <= stride && current_node != FrozenTrie::NO_NODE; ++length) {
+      power10 /= 10;
+      current_node = frozen_trie.get_child(current_node, (slot / power10) % 10);
+      if (current_node == FrozenTrie::NO_NODE)
+        break;
+      uint32_t record = frozen_trie.get_record(current_node);
+      if (record != RateStore::NO_RECORD) {
+        stride_match_t match;
+        match.record = record;
+        match.length = length;
+        matches.push_back(match);
+      }
+    }
+    if (current_node != FrozenTrie::NO_NODE && frozen_trie.has_children(current_node))
+      frozen_children[slot] = current_node;
+  }
+  for (uint32_t slot = 0; slot < fanout; ++slot) {
+    uint32_t child_offset = NO_NODE;
+    if (frozen_children[slot] != FrozenTrie::NO_NODE)
+      child_offset = expand_node(frozen_trie, frozen_children[slot]);
+    slots[slots_pos + slot].child = child_offset;
+  }
+  return node_offset;
+}
+
+unsigned char StrideTrie::get_stride() const {
+  return stride;
+}
+
+size_t StrideTrie::size() const {
+  return slots.size() / fanout;
+}
+
+/**
+    Bytes taken by the nodes and matches arrays (rate store excluded)
+*/
+size_t StrideTrie::memory_usage() const {
+  return sizeof(StrideTrie) + slots.capacity() * sizeof(stride_slot_t) + matches.capacity() * sizeof(stride_match_t);
+}
+
+/**
+    Longest prefix search implementation, same semantics as FrozenTrie::search_code.
+    A trailing chunk shorter than the stride is padded with zeros, keeping only the matches it fully covers.
+*/
+void StrideTrie::search_code(unsigned long long code, rate_type_t rate_type, time_t reference_time, search::SearchResult &search_result, uint32_t filter_code_name_id, bool include_code) const {
+  DigitCursor digit_cursor(code);
+  unsigned char digits_count = digit_cursor.size();
+  PrefixMatch match;
+  uint32_t current_node = 0;
+  unsigned long long current_code = 0;
+  for (unsigned char chunk_pos = 0; chunk_pos < digits_count && current_node != NO_NODE; chunk_pos += stride) {
+    unsigned char chunk_length = digits_count - chunk_pos < stride ? digits_count - chunk_pos : stride;
+    uint32_t slot = 0;
+    for (unsigned char i = 0; i < stride; ++i)
+      slot = slot * 10 + (i < chunk_length ? digit_cursor.get_digit(chunk_pos + i) : 0);
+    const stride_slot_t *current_slot = &slots[(size_t)current_node * fanout + slot];
+    uint32_t matches_end = (current_slot + 1)->matches_pos;
+    unsigned char prefix_length = 0;
+    unsigned long long prefix_code = current_code;
+    for (uint32_t i = current_slot->matches_pos; i < matches_end; ++i) {
+      const stride_match_t &stride_match = matches[i];
+      if (stride_match.length > chunk_length)
+        break;
+      for (; prefix_length < stride_match.length; ++prefix_length)
+        prefix_code = prefix_code * 10 + digit_cursor.get_digit(chunk_pos + prefix_length);
+      match.visit(rate_store, stride_match.record, prefix_code, rate_type, filter_code_name_id);
+    }
+    for (unsigned char i = 0; i < chunk_length; ++i)
+      current_code = current_code * 10 + digit_cursor.get_digit(chunk_pos + i);
+    current_node = current_slot->child;
+  }
+  match.insert_into(search_result, rate_table_id, rate_type, reference_time, include_code);
+}
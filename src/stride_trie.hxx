@@ -0,0 +1,56 @@
+/**
+      Multibit prefix tree: consumes several digits per level, using controlled prefix expansion
+*/
+#ifndef STRIDE_TRIE_HXX
+#define STRIDE_TRIE_HXX
+
+#include "rate_store.hxx"
+#include "search_result.hxx"
+#include "shared.hxx"
+#include <vector>
+#include <cstdint>
+#include <time.h>
+
+namespace trie {
+
+  class FrozenTrie;
+  class StrideTrie;
+  typedef StrideTrie* p_stride_trie_t;
+
+  /**
+      Each node has 10^stride slots, one per combination of the next stride digits. A slot holds
+      the child node and the records of every prefix ending within those digits (the prefix
+      expansion), sorted by length. Matches of a slot end where the matches of the next slot start.
+  */
+  typedef struct {
+    uint32_t child;
+    uint32_t matches_pos;
+  } stride_slot_t;
+
+  typedef struct {
+    uint32_t record;
+    uint32_t length;
+  } stride_match_t;
+
+  class StrideTrie {
+    private:
+      typedef std::vector<stride_slot_t> stride_slots_t;
+      typedef std::vector<stride_match_t> stride_matches_t;
+      unsigned char stride;
+      uint32_t fanout;
+      unsigned int rate_table_id;
+      p_rate_store_t rate_store;
+      stride_slots_t slots;
+      stride_matches_t matches;
+      uint32_t expand_node(const FrozenTrie &frozen_trie, uint32_t frozen_node);
+    public:
+      static const unsigned char MAX_STRIDE = 3;
+      static const uint32_t NO_NODE = UINT32_MAX;
+      StrideTrie(const FrozenTrie &frozen_trie, unsigned char stride);
+      unsigned char get_stride() const;
+      size_t size() const;
+      size_t memory_usage() const;
+      void search_code(unsigned long long code, rate_type_t rate_type, time_t reference_time, search::SearchResult &search_result, uint32_t filter_code_name_id = ctrl::NO_CODE_NAME_ID, bool include_code = false) const;
+  };
+}
+#endif
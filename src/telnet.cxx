@@ -9,6 +9,9 @@
 
 using namespace telnet;
 
+/** Commands starting with it answer in the binary format of SearchResult::to_binary */
+static const std::string BINARY_PREFIX = "binary ";
+
 Telnet::Telnet() {
   telnet_resources = new telnet_resources_t();
   telnet_ctxs = new telnet_ctxs_t();
@@ -36,11 +39,13 @@ void Telnet::register_resource(const std::string cmd, TelnetResource &resource)
 
 void Telnet::run_server(unsigned int telnet_listen_port) {
   TelnetSearchCode search_code;
+  TelnetSearchCodes search_codes;
   TelnetSearchCodeName search_code_name;
   TelnetSearchCodeNameAndRateTable search_code_name_rate_table;
   TelnetSearchRateTable search_rate_table;
   TelnetSearchAllCodes search_all_codes;
   register_resource("search_code", search_code);
+  register_resource("search_codes", search_codes);
   register_resource("search_code_name", search_code_name);
   register_resource("search_code_name_rate_table", search_code_name_rate_table);
   register_resource("search_rate_table", search_rate_table);
@@ -276,6 +281,9 @@ void Telnet::process_command(telnet_t *telnet, const char *buffer, size_t buffer
   std::string input = std::string(buffer, buffer_size);
   input.erase(std::remove(input.begin(), input.end(), '\r'), input.end()); //Cleaning input of CR & LF
   input.erase(std::remove(input.begin(), input.end(), '\n'), input.end());
+  bool binary = input.compare(0, BINARY_PREFIX.size(), BINARY_PREFIX) == 0;
+  if (binary)
+    input.erase(0, BINARY_PREFIX.size());
   if (input != "") {
     size_t pos = input.find_first_of(' ');
     std::string command;
@@ -286,7 +294,7 @@ void Telnet::process_command(telnet_t *telnet, const char *buffer, size_t buffer
     if (telnet_resources->find(command) == telnet_resources->end())
       telnet_printf(telnet, "Unrecognized command.");
     else {
-      std::string output = (*telnet_resources)[command]->process_command(input);
+      std::string output = (*telnet_resources)[command]->process_command(input, binary);
       telnet_send(telnet, output.c_str(), output.size());
     }
   }
@@ -1,6 +1,7 @@
 #include "telnet_resources.hxx"
 #include "controller.hxx"
 #include <iostream>
+#include <memory>
 
 
 using namespace telnet;
@@ -30,7 +31,38 @@ args_t TelnetResource::get_args(std::string input) {
 
 TelnetResource::~TelnetResource() {}
 
-std::string TelnetSearchCode::process_command(std::string input) {
+/**
+    Limits the result to the page asked by the arguments from the given one on: (limit), then
+    (offset) or the (cursor) returned with the previous page. Returns false if they are invalid.
+*/
+static bool set_result_page(const args_t &args, size_t page_arg, search::SearchResult &result) {
+  if (args.size() <= page_arg)
+    return true;
+  unsigned long limit = std::stoul(args[page_arg]);
+  if (std::to_string(limit) != args[page_arg])
+    return false;
+  if (!result.set_page(0, limit))
+    return false;
+  if (args.size() <= page_arg + 1)
+    return true;
+  const std::string &arg_offset = args[page_arg + 1];
+  if (arg_offset.find('.') != std::string::npos)
+    return result.set_cursor(arg_offset);
+  unsigned long offset = std::stoul(arg_offset);
+  if (std::to_string(offset) != arg_offset)
+    return false;
+  return result.set_page(offset, limit);
+}
+
+static std::string result_output(search::SearchResult &result, bool binary) {
+  if (result.is_stale())
+    return "Stale cursor: the rate tables were reloaded.";
+  if (binary)
+    return result.to_binary();
+  return result.to_text_table();
+}
+
+std::string TelnetSearchCode::process_command(std::string input, bool binary) {
   try {
     args_t args = get_args(input);
     if (args.size() < 1)
@@ -45,15 +77,52 @@ std::string TelnetSearchCode::process_command(std::string input) {
     if (std::to_string(code) != arg_code)
       return "Invalid code.";
     search::SearchResult result;
+    if (!set_result_page(args, 2, result))
+      return "Invalid page.";
     ctrl::p_controller_t p_controller = ctrl::Controller::get_controller();
     p_controller->search_code(code, rate_type, result);
-    return result.to_text_table();
+    return result_output(result, binary);
+  } catch (std::exception &e) {
+    return "Error";
+  }
+}
+
+/**
+    Answers with the result of each code, in the order of the arguments, each preceded by the
+    code searched, or binary messages one after the other
+*/
+std::string TelnetSearchCodes::process_command(std::string input, bool binary) {
+  try {
+    args_t args = get_args(input);
+    if (args.size() < 1)
+      return "Invalid arguments.";
+    if (args.size() > ctrl::MAX_CODE_QUERIES)
+      return "Too many codes: at most " + std::to_string(ctrl::MAX_CODE_QUERIES) + " per command.";
+    ctrl::code_queries_t code_queries;
+    for (auto it = args.begin(); it != args.end(); ++it)
+      code_queries.push_back(ctrl::parse_code_query(*it));
+    std::vector<std::unique_ptr<search::SearchResult>> results;
+    std::vector<search::p_search_result_t> batch_results;
+    for (auto it = code_queries.begin(); it != code_queries.end(); ++it) {
+      results.emplace_back(new search::SearchResult(it->days_ahead));
+      batch_results.push_back(results.back().get());
+    }
+    ctrl::p_controller_t p_controller = ctrl::Controller::get_controller();
+    p_controller->search_code_batch(code_queries, batch_results);
+    std::string output = "";
+    for (size_t i = 0; i < results.size(); ++i) {
+      if (binary)
+        output += results[i]->to_binary();
+      else
+        output += "searched_code         : " + std::to_string(code_queries[i].code) + "\n\n" + results[i]->to_text_table();
+    }
+    return output;
   } catch (std::exception &e) {
     return "Error";
   }
 }
 
-std::string TelnetSearchCodeName::process_command(std::string input) {
+std::string TelnetSearchCodeName::process_command(std::string input, bool binary) {
   try {
     args_t args = get_args(input);
     if (args.size() < 1)
@@ -65,15 +134,17 @@ std::string TelnetSearchCodeName::process_command(std::string input) {
       rate_type = trie::to_rate_type_t(arg_rate_type);
     }
     search::SearchResult result;
+    if (!set_result_page(args, 2, result))
+      return "Invalid page.";
     ctrl::p_controller_t p_controller = ctrl::Controller::get_controller();
     p_controller->search_code_name(code_name, rate_type, result);
-    return result.to_text_table();
+    return result_output(result, binary);
   } catch (std::exception &e) {
     return "Error";
   }
 }
 
-std::string TelnetSearchCodeNameAndRateTable::process_command(std::string input) {
+std::string TelnetSearchCodeNameAndRateTable::process_command(std::string input, bool binary) {
   try {
     args_t args = get_args(input);
     if (args.size() < 2)
@@ -89,15 +160,17 @@ std::string TelnetSearchCodeNameAndRateTable::process_command(std::string input)
     if (std::to_string(rate_table_id) != arg_rate_table_id)
       return "Invalid rate table id.";
     search::SearchResult result;
+    if (!set_result_page(args, 3, result))
+      return "Invalid page.";
     ctrl::p_controller_t p_controller = ctrl::Controller::get_controller();
     p_controller->search_code_name_rate_table(code_name, rate_table_id, rate_type, result);
-    return result.to_text_table();
+    return result_output(result, binary);
   } catch (std::exception &e) {
     return "Error";
   }
 }
 
-std::string TelnetSearchRateTable::process_command(std::string input) {
+std::string TelnetSearchRateTable::process_command(std::string input, bool binary) {
   try {
     args_t args = get_args(input);
     if (args.size() < 1)
@@ -112,15 +185,17 @@ std::string TelnetSearchRateTable::process_command(std::string input) {
     if (std::to_string(rate_table_id) != arg_rate_table_id)
       return "Invalid rate table id.";
     search::SearchResult result;
+    if (!set_result_page(args, 2, result))
+      return "Invalid page.";
     ctrl::p_controller_t p_controller = ctrl::Controller::get_controller();
     p_controller->search_rate_table(rate_table_id, rate_type, result);
-    return result.to_text_table();
+    return result_output(result, binary);
   } catch (std::exception &e) {
     return "Error";
   }
 }
 
-std::string TelnetSearchAllCodes::process_command(std::string input) {
+std::string TelnetSearchAllCodes::process_command(std::string input, bool binary) {
   try {
     trie::rate_type_t rate_type = trie::rate_type_t::RATE_TYPE_DEFAULT;
     args_t args = get_args(input);
@@ -129,9 +204,11 @@ std::string TelnetSearchAllCodes::process_command(std::string input) {
       rate_type = trie::to_rate_type_t(arg_rate_type);
     }
     search::SearchResult result;
+    if (!set_result_page(args, 1, result))
+      return "Invalid page.";
     ctrl::p_controller_t p_controller = ctrl::Controller::get_controller();
     p_controller->search_all_codes(rate_type, result);
-    return result.to_text_table();
+    return result_output(result, binary);
   } catch (std::exception &e) {
     return "Error";
   }
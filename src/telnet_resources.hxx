@@ -11,34 +11,40 @@ typedef std::vector<std::string> args_t;
 class TelnetResource {
   public:
     virtual ~TelnetResource();
-    virtual std::string process_command(std::string input) = 0;
+    virtual std::string process_command(std::string input, bool binary) = 0;
     args_t get_args(std::string input);
 
 };
 
 class TelnetSearchCode : public TelnetResource  {
   public:
-    std::string process_command(std::string input);
+    std::string process_command(std::string input, bool binary);
+};
+
+/** Batch lookup: one argument per code, as (code[,rate_type[,days_ahead]]) */
+class TelnetSearchCodes : public TelnetResource  {
+  public:
+    std::string process_command(std::string input, bool binary);
 };
 
 class TelnetSearchCodeName : public TelnetResource  {
   public:
-    std::string process_command(std::string input);
+    std::string process_command(std::string input, bool binary);
 };
 
 class TelnetSearchCodeNameAndRateTable : public TelnetResource  {
   public:
-    std::string process_command(std::string input);
+    std::string process_command(std::string input, bool binary);
 };
 
 class TelnetSearchRateTable : public TelnetResource  {
   public:
-    std::string process_command(std::string input);
+    std::string process_command(std::string input, bool binary);
 };
 
 class TelnetSearchAllCodes : public TelnetResource  {
   public:
-    std::string process_command(std::string input);
+    std::string process_command(std::string input, bool binary);
 };
 }
 
@@ -1,430 +1,103 @@
 #include "trie.hxx"
-#include "code.hxx"
+#include "digit_cursor.hxx"
+#include "frozen_trie.hxx"
 #include "exceptions.hxx"
 #include "logger.hxx"
 #include <algorithm>
 #include <iostream>
+#include <vector>
 
 using namespace trie;
 
-TrieData::TrieData() {
-  fields = nullptr;
-  fields_bitmap = 0;
-  fields_size = 0;
-}
-
-TrieData::~TrieData() {
-  for (uint32_t key = CURRENT_DEFAULT_RATE; key != EMPTY_FLAG; key >>= 1)
-    if ((fields_bitmap & key) && key != CODE_NAME_ADDRESS)
-        free(fields[key_to_field_pos((trie_data_field_t)key)]);
-  free(fields);
-}
-
-unsigned char TrieData::key_to_field_pos(trie_data_field_t key) {
-  unsigned char pos = 0;
-  uint32_t mask = key;
-  uint32_t bitmap = fields_bitmap;
-  while (mask != 0x80000000) {
-    if (bitmap & 0x80000000) pos++;
-    bitmap <<= 1;
-    mask <<= 1;
-  }
-  return pos;
-}
-
-template <typename T> T TrieData::get_field(trie_data_field_t key) {
-  if (fields_bitmap & key)
-    return *(T*)fields[key_to_field_pos(key)];
-  else
-    return -1;
-}
-
-namespace trie {
-  template <> unsigned int TrieData::get_field<unsigned int>(trie_data_field_t key) {
-    if (fields_bitmap & key)
-      return *(int*)fields[key_to_field_pos(key)];
-    else
-      return 0;
-  }
-};
-
-
-template <typename T> void TrieData::set_field(trie_data_field_t key, T value) {
-  if (value <= 0)
-    return;
-  unsigned char field_pos = key_to_field_pos(key);
-  if ((fields_bitmap & key) == 0) {
-    fields_size += sizeof(void*);
-    fields = (void**)realloc(fields, fields_size);
-    unsigned char count = fields_size / sizeof(void*);
-    for (size_t i = count - 1; i > field_pos; --i)
-      fields[i] = fields[i-1];
-    fields[field_pos] = malloc(sizeof(T));
-    fields_bitmap |= key;
-  }
-  *(T*)fields[field_pos] = value;
-}
-
-double TrieData::get_current_rate(rate_type_t rate_type) {
-  switch (rate_type) {
-    case RATE_TYPE_INTER:
-      return get_field<double>(CURRENT_INTER_RATE);
-      break;
-    case RATE_TYPE_INTRA:
-      return get_field<double>(CURRENT_INTRA_RATE);
-      break;
-    case RATE_TYPE_LOCAL:
-      return get_field<double>(CURRENT_LOCAL_RATE);
-      break;
-    default:
-      return get_field<double>(CURRENT_DEFAULT_RATE);
-  }
-}
-
-time_t TrieData::get_current_effective_date(rate_type_t rate_type) {
-  switch (rate_type) {
-    case RATE_TYPE_INTER:
-      return get_field<time_t>(CURRENT_INTER_EFFECTIVE_DATE);
-      break;
-    case RATE_TYPE_INTRA:
-      return get_field<time_t>(CURRENT_INTRA_EFFECTIVE_DATE);
-      break;
-    case RATE_TYPE_LOCAL:
-      return get_field<time_t>(CURRENT_LOCAL_EFFECTIVE_DATE);
-      break;
-    default:
-      return get_field<time_t>(CURRENT_DEFAULT_EFFECTIVE_DATE);
-  }
-}
-
-time_t TrieData::get_current_end_date(rate_type_t rate_type) {
-  switch (rate_type) {
-    case RATE_TYPE_INTER:
-      return get_field<time_t>(CURRENT_INTER_END_DATE);
-      break;
-    case RATE_TYPE_INTRA:
-      return get_field<time_t>(CURRENT_INTRA_END_DATE);
-      break;
-    case RATE_TYPE_LOCAL:
-      return get_field<time_t>(CURRENT_LOCAL_END_DATE);
-      break;
-    default:
-      return get_field<time_t>(CURRENT_DEFAULT_END_DATE);
-  }
-}
-
-void TrieData::set_current_rate(rate_type_t rate_type, double rate) {
-  switch (rate_type) {
-    case RATE_TYPE_INTER:
-      set_field<double>(CURRENT_INTER_RATE, rate);
-      break;
-    case RATE_TYPE_INTRA:
-      set_field<double>(CURRENT_INTRA_RATE, rate);
-      break;
-    case RATE_TYPE_LOCAL:
-      set_field<double>(CURRENT_LOCAL_RATE, rate);
-      break;
-    default:
-      set_field<double>(CURRENT_DEFAULT_RATE, rate);
-  }
-}
-
-void TrieData::set_current_effective_date(rate_type_t rate_type, time_t effective_date) {
-  switch (rate_type) {
-    case RATE_TYPE_INTER:
-      set_field<time_t>(CURRENT_INTER_EFFECTIVE_DATE, effective_date);
-      break;
-    case RATE_TYPE_INTRA:
-      set_field<time_t>(CURRENT_INTRA_EFFECTIVE_DATE, effective_date);
-      break;
-    case RATE_TYPE_LOCAL:
-      set_field<time_t>(CURRENT_LOCAL_EFFECTIVE_DATE, effective_date);
-      break;
-    default:
-      set_field<time_t>(CURRENT_DEFAULT_EFFECTIVE_DATE, effective_date);
-  }
-}
-
-void TrieData::set_current_end_date(rate_type_t rate_type, time_t end_date) {
-  switch (rate_type) {
-    case RATE_TYPE_INTER:
-      set_field<time_t>(CURRENT_INTER_END_DATE, end_date);
-      break;
-    case RATE_TYPE_INTRA:
-      set_field<time_t>(CURRENT_INTRA_END_DATE, end_date);
-      break;
-    case RATE_TYPE_LOCAL:
-      set_field<time_t>(CURRENT_LOCAL_END_DATE, end_date);
-      break;
-    default:
-      set_field<time_t>(CURRENT_DEFAULT_END_DATE, end_date);
-  }
-}
-
-double TrieData::get_future_rate(rate_type_t rate_type) {
-  switch (rate_type) {
-    case RATE_TYPE_INTER:
-      return get_field<double>(FUTURE_INTER_RATE);
-      break;
-    case RATE_TYPE_INTRA:
-      return get_field<double>(FUTURE_INTRA_RATE);
-      break;
-    case RATE_TYPE_LOCAL:
-      return get_field<double>(FUTURE_LOCAL_RATE);
-      break;
-    default:
-      return get_field<double>(FUTURE_DEFAULT_RATE);
-  }
-}
-
-time_t TrieData::get_future_effective_date(rate_type_t rate_type) {
-  switch (rate_type) {
-    case RATE_TYPE_INTER:
-      return get_field<time_t>(FUTURE_INTER_EFFECTIVE_DATE);
-      break;
-    case RATE_TYPE_INTRA:
-      return get_field<time_t>(FUTURE_INTRA_EFFECTIVE_DATE);
-      break;
-    case RATE_TYPE_LOCAL:
-      return get_field<time_t>(FUTURE_LOCAL_EFFECTIVE_DATE);
-      break;
-    default:
-      return get_field<time_t>(FUTURE_DEFAULT_EFFECTIVE_DATE);
-  }
-}
-
-time_t TrieData::get_future_end_date(rate_type_t rate_type) {
-  switch (rate_type) {
-    case RATE_TYPE_INTER:
-      return get_field<time_t>(FUTURE_INTER_END_DATE);
-      break;
-    case RATE_TYPE_INTRA:
-      return get_field<time_t>(FUTURE_INTRA_END_DATE);
-      break;
-    case RATE_TYPE_LOCAL:
-      return get_field<time_t>(FUTURE_LOCAL_END_DATE);
-      break;
-    default:
-      return get_field<time_t>(FUTURE_DEFAULT_END_DATE);
-  }
-}
+std::atomic<unsigned long long> Trie::child_creation_races(0);
+std::atomic<unsigned long long> Trie::record_publication_races(0);
 
-void TrieData::set_future_rate(rate_type_t rate_type, double rate) {
-  switch (rate_type) {
-    case RATE_TYPE_INTER:
-      set_field<double>(FUTURE_INTER_RATE, rate);
-      break;
-    case RATE_TYPE_INTRA:
-      set_field<double>(FUTURE_INTRA_RATE, rate);
-      break;
-    case RATE_TYPE_LOCAL:
-      set_field<double>(FUTURE_LOCAL_RATE, rate);
-      break;
-    default:
-      set_field<double>(FUTURE_DEFAULT_RATE, rate);
-  }
-}
-
-void TrieData::set_future_effective_date(rate_type_t rate_type, time_t effective_date) {
-  switch (rate_type) {
-    case RATE_TYPE_INTER:
-      set_field<time_t>(FUTURE_INTER_EFFECTIVE_DATE, effective_date);
-      break;
-    case RATE_TYPE_INTRA:
-      set_field<time_t>(FUTURE_INTRA_EFFECTIVE_DATE, effective_date);
-      break;
-    case RATE_TYPE_LOCAL:
-      set_field<time_t>(FUTURE_LOCAL_EFFECTIVE_DATE, effective_date);
-      break;
-    default:
-      set_field<time_t>(FUTURE_DEFAULT_EFFECTIVE_DATE, effective_date);
-  }
-}
-
-void TrieData::set_future_end_date(rate_type_t rate_type, time_t end_date) {
-  switch (rate_type) {
-    case RATE_TYPE_INTER:
-      set_field<time_t>(FUTURE_INTER_END_DATE, end_date);
-      break;
-    case RATE_TYPE_INTRA:
-      set_field<time_t>(FUTURE_INTRA_END_DATE, end_date);
-      break;
-    case RATE_TYPE_LOCAL:
-      set_field<time_t>(FUTURE_LOCAL_END_DATE, end_date);
-      break;
-    default:
-      set_field<time_t>(FUTURE_DEFAULT_END_DATE, end_date);
-  }
-}
-
-int TrieData::get_table_index() {
-  return get_field<int>(TABLE_INDEX);
-}
-
-void TrieData::set_table_index(size_t table_index) {
-  set_field<int>(TABLE_INDEX, table_index);
-}
-
-std::string TrieData::get_code_name() {
-  if (fields_bitmap & CODE_NAME_ADDRESS)
-    return ((ctrl::p_code_pair_t)fields[key_to_field_pos(CODE_NAME_ADDRESS)])->first;
-  else
-    return "";
-}
-
-void TrieData::set_code_name(ctrl::p_code_pair_t code_item) {
-  unsigned char field_pos = key_to_field_pos(CODE_NAME_ADDRESS);
-  if ((fields_bitmap & CODE_NAME_ADDRESS) == 0) {
-    fields_size += sizeof(void*);
-    fields = (void**)realloc(fields, fields_size);
-    unsigned char count = fields_size / sizeof(void*);
-    for (size_t i = count - 1; i > field_pos; --i)
-      fields[i] = fields[i-1];
-    fields_bitmap |= CODE_NAME_ADDRESS;
-  }
-  fields[field_pos] = code_item;
-}
-
-void TrieData::set_egress_trunk_id(rate_type_t rate_type, unsigned int egress_trunk_id) {
-  switch (rate_type) {
-    case RATE_TYPE_INTER:
-      set_field<unsigned int>(INTER_RATE_EGRESS_TRUNK_ID, egress_trunk_id);
-      break;
-    case RATE_TYPE_INTRA:
-      set_field<unsigned int>(INTRA_RATE_EGRESS_TRUNK_ID, egress_trunk_id);
-      break;
-    case RATE_TYPE_LOCAL:
-      set_field<unsigned int>(LOCAL_RATE_EGRESS_TRUNK_ID, egress_trunk_id);
-      break;
-    default:
-      set_field<unsigned int>(DEFAULT_RATE_EGRESS_TRUNK_ID, egress_trunk_id);
-  }
-}
-
-unsigned int TrieData::get_egress_trunk_id(rate_type_t rate_type) {
-  switch (rate_type) {
-    case RATE_TYPE_INTER:
-      return get_field<unsigned int>(INTER_RATE_EGRESS_TRUNK_ID);
-      break;
-    case RATE_TYPE_INTRA:
-      return get_field<unsigned int>(INTRA_RATE_EGRESS_TRUNK_ID);
-      break;
-    case RATE_TYPE_LOCAL:
-      return get_field<unsigned int>(LOCAL_RATE_EGRESS_TRUNK_ID);
-      break;
-    default:
-      return get_field<unsigned int>(DEFAULT_RATE_EGRESS_TRUNK_ID);
-  }
-}
-
-unsigned int TrieData::get_rate_table_id() {
-  return get_field<unsigned int>(RATE_TABLE_ID);
-}
-
-void TrieData::set_rate_table_id(unsigned int rate_table_id) {
-  set_field<unsigned int>(RATE_TABLE_ID, rate_table_id);
-}
-
-Trie::Trie(unsigned int worker_index)
-  : worker_index(worker_index),
-    children_bitmap(0),
-    children_size(0),
-    data(new TrieData()),
+Trie::Trie(unsigned int rate_table_id)
+  : rate_table_id(rate_table_id),
+    record(nullptr),
     children(nullptr) {}
 
-Trie::~Trie() {
-  /** IMPORTANT: Individual child disposal is delegated to Controller release queues to be done by tasks/workers **/
-
-  /*size_t count = children_size / sizeof(p_trie_t);
-  for (unsigned char i=0; i < count; ++i)
-    delete children[i];*/
-  free(children);
-  delete data;
-}
-
-unsigned int Trie::get_worker_index() {
-  return worker_index;
+unsigned int Trie::get_rate_table_id() {
+  return rate_table_id;
 }
 
-p_trie_data_t Trie::get_data() {
-  return data;
+p_rate_record_t Trie::get_record() {
+  return record.load(std::memory_order_acquire);
 }
 
-void Trie::set_current_data(rate_type_t rate_type, double rate, time_t reference_time, time_t effective_date, time_t end_date, ctrl::p_code_pair_t code_item, unsigned int egress_trunk_id) {
-  if ( effective_date <= reference_time && effective_date > data->get_current_effective_date(rate_type) &&
-      (end_date <= 0 || end_date >= reference_time)) {
-        data->set_current_rate(rate_type, rate);
-        data->set_current_effective_date(rate_type, effective_date);
-        data->set_current_end_date(rate_type, end_date);
-        data->set_code_name(code_item);
-        data->set_egress_trunk_id(rate_type, egress_trunk_id);
-  }
-  if (effective_date > reference_time && (data->get_future_rate(rate_type) == -1 || effective_date < data->get_future_effective_date(rate_type))) {
-    data->set_future_rate(rate_type, rate);
-    data->set_future_effective_date(rate_type, effective_date);
-    data->set_future_end_date(rate_type, end_date);
-    if (data->get_current_end_date(rate_type) >= effective_date)
-      data->set_current_end_date(rate_type, effective_date - 1);
-  }
-}
-
-uint16_t Trie::index_to_mask(unsigned char index) {
-  if (index < 0 || index > 9)
-    throw TrieInvalidChildIndexException();
-  return 1 << abs(index - 15);
-}
-
-unsigned char Trie::index_to_child_pos(unsigned char index) {
-  if (index < 0 || index > 9)
-    throw TrieInvalidChildIndexException();
-  unsigned char pos = 0;
-  unsigned char bits_limit = index;
-  uint16_t bitmap = children_bitmap;
-  while (bits_limit > 0) {
-    if (bitmap & 0x8000) pos++;
-    bitmap <<= 1;
-    bits_limit--;
-  }
-  return pos;
+/**
+    Returns the races counted since the previous call and resets them
+*/
+insertion_races_t Trie::take_insertion_races() {
+  insertion_races_t insertion_races;
+  insertion_races.child_creation_races = child_creation_races.exchange(0);
+  insertion_races.record_publication_races = record_publication_races.exchange(0);
+  return insertion_races;
 }
 
 bool Trie::has_child(unsigned char index) {
-  if (index < 0 || index > 9)
-    throw TrieInvalidChildIndexException();
-  uint16_t mask = index_to_mask(index);
-  return children_bitmap & mask;
+  return get_child(index) != nullptr;
 }
 
 p_trie_t Trie::get_child(unsigned char index) {
-  if (index < 0 || index > 9)
+  if (index > 9)
     throw TrieInvalidChildIndexException();
-  return children[index_to_child_pos(index)];
+  p_trie_children_t current_children = children.load(std::memory_order_acquire);
+  if (!current_children)
+    return nullptr;
+  return current_children[index].load(std::memory_order_acquire);
 }
 
-p_trie_t Trie::insert_child(unsigned int worker_index, unsigned char index) {
-  if (index < 0 || index > 9)
+/**
+    Returns the child at the given index, creating it if needed. When another loader creates
+    the same children array or child first, ours is left unused in the arena and theirs is used.
+*/
+p_trie_t Trie::find_or_insert_child(ctrl::p_arena_t arena, unsigned char index) {
+  if (index > 9)
     throw TrieInvalidChildIndexException();
-  children_size += sizeof(p_trie_t);
-  children = (p_trie_t*)realloc(children, children_size);
-  size_t count = children_size / sizeof(p_trie_t);
-  unsigned char child_pos = index_to_child_pos(index);
-  for (size_t i = count - 1; i > child_pos; --i)
-    children[i] = children[i-1];
-  children[child_pos] = new Trie(worker_index);
-  uint16_t child_mask = index_to_mask(index);
-  children_bitmap |= child_mask;
-  return children[child_pos];
+  p_trie_children_t current_children = children.load(std::memory_order_acquire);
+  if (!current_children) {
+    p_trie_children_t new_children = static_cast<p_trie_children_t>(arena->allocate(10 * sizeof(trie_child_t)));
+    for (unsigned char i = 0; i < 10; ++i)
+      new (&new_children[i]) trie_child_t(nullptr);
+    if (children.compare_exchange_strong(current_children, new_children, std::memory_order_acq_rel))
+      current_children = new_children;
+    else
+      child_creation_races++;
+  }
+  p_trie_t child = current_children[index].load(std::memory_order_acquire);
+  if (child)
+    return child;
+  p_trie_t new_child = arena->create<Trie>();
+  if (current_children[index].compare_exchange_strong(child, new_child, std::memory_order_acq_rel))
+    return new_child;
+  child_creation_races++;
+  return child;
 }
 
-tbb::mutex* Trie::get_mutex() {
-  return &trie_insertion_mutex;
+/**
+    Applies a rate row to a copy of the current record and swaps the copy in, retrying
+    over the latest record whenever another loader published first
+*/
+void Trie::publish_record(ctrl::p_arena_t arena, const double rates[RATE_TYPES_COUNT], time_t reference_time, time_t effective_date, time_t end_date, ctrl::p_code_pair_t code_item, unsigned int egress_trunk_id) {
+  p_rate_record_t current_record = record.load(std::memory_order_acquire);
+  p_rate_record_t new_record = arena->create<RateRecord>();
+  while (true) {
+    new_record->copy_from(current_record);
+    for (unsigned char i = 0; i < RATE_TYPES_COUNT; ++i)
+      if (rates[i] > 0)   //Don't update rate data if it is inexistent
+        new_record->update((rate_type_t)i, rates[i], reference_time, effective_date, end_date, code_item, egress_trunk_id);
+    if (record.compare_exchange_strong(current_record, new_record, std::memory_order_acq_rel))
+      return;
+    record_publication_races++;
+  }
 }
 
 /**
     Inserts rate data in the prefix tree at the correct prefix location
 */
 void Trie::insert_code(const p_trie_t trie,
-                       unsigned int worker_index,
+                       ctrl::p_arena_t arena,
                        unsigned long long code,
                        ctrl::p_code_pair_t code_item,
                        unsigned int rate_table_id,
@@ -436,53 +109,60 @@ void Trie::insert_code(const p_trie_t trie,
                        time_t end_date,
                        time_t reference_time,
                        unsigned int egress_trunk_id) {
-  p_trie_data_t root_data = trie->get_data();
-  unsigned int root_rate_table_id = root_data->get_rate_table_id();
-  if (root_rate_table_id == 0)
-    root_data->set_rate_table_id(rate_table_id);
-  else if (root_rate_table_id != rate_table_id)
+  if (trie->rate_table_id != rate_table_id)
     throw TrieWrongRateTableException();
+  double rates[RATE_TYPES_COUNT];
+  rates[RATE_TYPE_DEFAULT] = default_rate;
+  rates[RATE_TYPE_INTER] = inter_rate;
+  rates[RATE_TYPE_INTRA] = intra_rate;
+  rates[RATE_TYPE_LOCAL] = local_rate;
   p_trie_t current_trie = trie;
-  Code dyn_code(code);
-  while (dyn_code.has_more_digits()) {
-    unsigned char child_index = dyn_code.next_digit();
-    if (current_trie->has_child(child_index))
-      current_trie = current_trie->get_child(child_index);
-    else
-      current_trie = current_trie->insert_child(worker_index, child_index);
-  }
-  for (int i = RATE_TYPE_DEFAULT; i <= RATE_TYPE_LOCAL; i++) {
-    rate_type_t rate_type = (rate_type_t)i;
-    double rate;
-    switch (rate_type) {
-      case RATE_TYPE_INTER:
-        rate = inter_rate;
-        break;
-      case RATE_TYPE_INTRA:
-        rate = intra_rate;
-        break;
-      case RATE_TYPE_LOCAL:
-        rate = local_rate;
-        break;
-      case RATE_TYPE_DEFAULT:
-        rate = default_rate;
-        break;
-      default:
-        continue;
+  DigitCursor digit_cursor(code);
+  while (digit_cursor.has_more_digits())
+    current_trie = current_trie->find_or_insert_child(arena, digit_cursor.next_digit());
+  if (default_rate > 0 || inter_rate > 0 || intra_rate > 0 || local_rate > 0)
+    current_trie->publish_record(arena, rates, reference_time, effective_date, end_date, code_item, egress_trunk_id);
+}
+
+/**
+    Copies every record of a frozen prefix tree into an empty prefix tree of the same rate table,
+    so new rate rows can be inserted on top of them (code name ids resolved in the given code names)
+*/
+void Trie::thaw(const p_trie_t trie, ctrl::p_arena_t arena, const FrozenTrie &frozen_trie, const ctrl::CodeNames &code_names) {
+  if (trie->rate_table_id != frozen_trie.get_rate_table_id())
+    throw TrieWrongRateTableException();
+  if (frozen_trie.is_restrided())
+    throw TrieThawRestridedException();
+  p_rate_store_t rate_store = frozen_trie.get_rate_store();
+  std::vector<std::pair<uint32_t, p_trie_t>> pending_nodes(1, std::make_pair((uint32_t)0, trie));
+  while (!pending_nodes.empty()) {
+    uint32_t frozen_node = pending_nodes.back().first;
+    p_trie_t current_trie = pending_nodes.back().second;
+    pending_nodes.pop_back();
+    uint32_t record = frozen_trie.get_record(frozen_node);
+    if (record != RateStore::NO_RECORD) {
+      p_rate_record_t rate_record = arena->create<RateRecord>();
+      rate_store->copy_record(record, *rate_record, code_names);
+      current_trie->record.store(rate_record, std::memory_order_release);
+    }
+    if (!frozen_trie.has_children(frozen_node))
+      continue;
+    for (unsigned char i = 0; i < 10; ++i) {
+      uint32_t child = frozen_trie.get_child(frozen_node, i);
+      if (child != FrozenTrie::NO_NODE)
+        pending_nodes.push_back(std::make_pair(child, current_trie->find_or_insert_child(arena, i)));
     }
-    if (rate <= 0) continue;  //Don't update rate data if it is inexistent
-    current_trie->set_current_data(rate_type, rate, reference_time, effective_date, end_date, code_item, egress_trunk_id);
   }
 }
 
 /**
     Longest prefix search implementation... sort of
 */
-void Trie::search_code(const p_trie_t trie, unsigned long long code, rate_type_t rate_type, time_t reference_time, search::SearchResult &search_result, const std::string &filter_code_name, bool include_code) {
-  unsigned int rate_table_id = trie->get_data()->get_rate_table_id();
+void Trie::search_code(const p_trie_t trie, unsigned long long code, rate_type_t rate_type, time_t reference_time, search::SearchResult &search_result, uint32_t filter_code_name_id, bool include_code) {
+  unsigned int rate_table_id = trie->rate_table_id;
   p_trie_t current_trie = trie;
   unsigned long long code_found = 0, current_code = 0;
-  std::string code_name;
+  uint32_t code_name_id = ctrl::NO_CODE_NAME_ID;
   double current_min_rate = -1;
   double current_max_rate = -1;
   double future_min_rate = -1;
@@ -492,32 +172,34 @@ void Trie::search_code(const p_trie_t trie, unsigned long long code, rate_type_t
   time_t future_effective_date;
   time_t future_end_date;
   unsigned int egress_trunk_id;
-  Code dyn_code(code);
+  DigitCursor digit_cursor(code);
   bool children_found = true;
-  while (children_found && dyn_code.has_more_digits()) {
-    unsigned char child_index = dyn_code.next_digit();
+  while (children_found && digit_cursor.has_more_digits()) {
+    unsigned char child_index = digit_cursor.next_digit();
     if (current_trie->has_child(child_index)) {         // If we have a child node, move to it so we can search the longest prefix
       current_trie = current_trie->get_child(child_index);
       current_code =  current_code * 10 + child_index;
-      p_trie_data_t data = current_trie->get_data();
-      double data_current_rate = data->get_current_rate(rate_type);
-      time_t data_current_effective_date = data->get_current_effective_date(rate_type);
-      time_t data_current_end_date = data->get_current_end_date(rate_type);
-      double data_future_rate = data->get_future_rate(rate_type);
-      time_t data_future_effective_date = data->get_future_effective_date(rate_type);
-      time_t data_future_end_date = data->get_future_end_date(rate_type);
+      p_rate_record_t record = current_trie->get_record();
+      if (!record)
+        continue;
+      double data_current_rate = record->get_current_rate(rate_type);
+      time_t data_current_effective_date = record->get_current_effective_date(rate_type);
+      time_t data_current_end_date = record->get_current_end_date(rate_type);
+      double data_future_rate = record->get_future_rate(rate_type);
+      time_t data_future_effective_date = record->get_future_effective_date(rate_type);
+      time_t data_future_end_date = record->get_future_end_date(rate_type);
       if (data_current_rate > 0 ) {
         if (current_min_rate <=0 || data_current_rate < current_min_rate)
           current_min_rate = data_current_rate;
         //if (current_max_rate <=0 || data_current_rate > current_max_rate) {
-          code_name = data->get_code_name();
-          if (filter_code_name != "" && code_name != filter_code_name)
+          code_name_id = record->get_code_name_id();
+          if (filter_code_name_id != ctrl::NO_CODE_NAME_ID && code_name_id != filter_code_name_id)
             continue;
           code_found = current_code;
           current_max_rate = data_current_rate;
           current_effective_date = data_current_effective_date;
           current_end_date = data_current_end_date;
-          egress_trunk_id = data->get_egress_trunk_id(rate_type);
+          egress_trunk_id = record->get_egress_trunk_id(rate_type);
           if (future_min_rate <=0 || data_future_rate < future_min_rate)
             future_min_rate = data_future_rate;
           //if (future_max_rate <=0 || data_future_rate > future_max_rate) {
@@ -533,7 +215,7 @@ void Trie::search_code(const p_trie_t trie, unsigned long long code, rate_type_t
   }
   if (code_found) {
     search_result.insert(include_code ? code_found : 0,
-                         code_name,
+                         code_name_id,
                          rate_table_id,
                          rate_type,
                          current_min_rate,
@@ -548,153 +230,3 @@ void Trie::search_code(const p_trie_t trie, unsigned long long code, rate_type_t
                          egress_trunk_id);
   }
 }
-
-/**
-    Search a prefix tree in pre-order
-*/
-/*void Trie::total_search_code(const p_trie_t trie, rate_type_t rate_type, search::SearchResult &search_result) {
-  search_nodes_t nodes;  //Use vector as a stack, to be able to access ancestor elements to know the rate code
-  nodes.emplace_back(new search_node_t({0, trie}));
-  unsigned long long code_found = 0;
-  std::string code_name;
-  double current_min_rate = -1;
-  double current_max_rate = -1;
-  double future_min_rate = -1;
-  double future_max_rate = -1;
-  time_t effective_date;
-  time_t end_date;
-  time_t future_effective_date;
-  time_t future_end_date;
-  p_trie_t current_trie;
-  unsigned char child_index = 1;
-  unsigned int rate_table_id = trie->get_data()->get_rate_table_id();
-  while (child_index < 10 && !trie->has_child(child_index))
-    child_index++;
-  if (child_index == 10)
-    return;
-  else
-    current_trie = trie->get_child(child_index);
-  while (!nodes.empty()) {
-    ** Update the searched variables from the current (parent) prefix tree
-    nodes.emplace_back(new search_node_t({child_index, current_trie}));
-    total_search_update_vars(current_trie, nodes, code_found, code_name, rate_type,
-                             current_min_rate, current_max_rate, future_min_rate, future_max_rate,
-                             effective_date, end_date, future_effective_date, future_end_date);
-
-
-    ** Continue the search algorithm visiting the left-most child
-    while (current_trie->has_child(0)) {
-      current_trie = current_trie->get_child(0);
-      ** Update the searched variables from the current (left-most child) prefix tree
-      nodes.emplace_back(new search_node_t({0, current_trie}));
-      total_search_update_vars(current_trie, nodes, code_found, code_name, rate_type,
-                               effective_date, end_date, future_effective_date, future_end_date);
-                               current_min_rate, current_max_rate, future_min_rate, future_max_rate,
-    }
-
-    ** Continue the search algorithm to the right: selecting a sibling or uncle prefix tree node
-    p_search_node_t last_node = nodes.back();
-    p_trie_t prev_trie = current_trie;
-    while (!nodes.empty() && prev_trie == current_trie) {
-      if (child_index == 9) {
-        child_index = last_node->child_index;
-        nodes.pop_back();
-        last_node = nodes.back();
-      }
-      else if (last_node->trie->has_child(++child_index))
-        current_trie = last_node->trie->get_child(child_index);
-    }
-  }
-  if (code_found)
-    search_result.insert(code_found,
-                         code_name,
-                         rate_table_id,
-                         rate_type,
-                         current_min_rate,
-                         current_max_rate,
-                         future_min_rate,
-                         future_max_rate,
-                         effective_date,
-                         end_date,
-                         future_effective_date,
-                         future_end_date);
-  for (size_t i = 0; i < nodes.size(); ++i)
-    delete nodes[i];
-  nodes.clear();
-}*/
-
-void Trie::total_search_update_vars(const p_trie_t &current_trie,
-                                    const search_nodes_t &nodes,
-                                    unsigned long long &code,
-                                    std::string &code_name,
-                                    const rate_type_t rate_type,
-                                    double &current_min_rate,
-                                    double &current_max_rate,
-                                    double &future_min_rate,
-                                    double &future_max_rate,
-                                    time_t &current_effective_date,
-                                    time_t &current_end_date,
-                                    time_t &future_effective_date,
-                                    time_t &future_end_date) {
-  p_trie_data_t data = current_trie->get_data();
-  double data_current_rate = data->get_current_rate(rate_type);
-  time_t data_current_effective_date = data->get_current_effective_date(rate_type);
-  time_t data_current_end_date = data->get_current_end_date(rate_type);
-  double data_future_rate = data->get_future_rate(rate_type);
-  time_t data_future_effective_date = data->get_future_effective_date(rate_type);
-  time_t data_future_end_date = data->get_future_end_date(rate_type);
-  if (data_current_rate > 0) {
-    if (current_min_rate <=  0 || data_current_rate < current_min_rate)
-      current_min_rate = data_current_rate;
-    if (current_max_rate <=  0 || data_current_rate > current_max_rate) {
-      code = 0;
-      for (auto it = nodes.begin(); it != nodes.end(); ++it)
-        code = code * 10 + (*it)->child_index;
-      current_max_rate = data_current_rate;
-      current_effective_date = data_current_effective_date;
-      current_end_date = data_current_end_date;
-      code_name = data->get_code_name();
-    }
-    if (future_min_rate <=  0 || data_future_rate < future_min_rate)
-      future_min_rate = data_future_rate;
-    if (future_max_rate <=  0 || data_future_rate > future_max_rate) {
-      future_max_rate = data_future_rate;
-      future_effective_date = data_future_effective_date;
-      future_end_date = data_future_end_date;
-    }
-  }
-}
-
-/*void Trie::insert_table_index(const p_trie_t trie, unsigned int worker_index, unsigned int rate_table_id, size_t index) {
-  p_trie_t current_trie = trie;
-  Code dyn_rate_table_id(rate_table_id);
-  while (dyn_rate_table_id.has_more_digits()) {
-    unsigned char child_index = dyn_rate_table_id.next_digit();
-    if (current_trie->has_child(child_index))
-      current_trie = current_trie->get_child(child_index);
-    else
-      current_trie = current_trie->insert_child(worker_index, child_index);
-  }
-  p_trie_data_t trie_data = current_trie->get_data();
-  trie_data->set_table_index(index);
-}
-
-int Trie::search_table_index(const p_trie_t trie, unsigned int rate_table_id) {
-  p_trie_t current_trie = trie;
-  Code dyn_rate_table_id(rate_table_id);
-  bool children_found = true;
-  while (children_found && dyn_rate_table_id.has_more_digits()) {
-    unsigned char child_index = dyn_rate_table_id.next_digit();
-    if (current_trie->has_child(child_index))
-      current_trie = current_trie->get_child(child_index);
-    else
-      children_found = false;
-  }
-  if (children_found) {
-    p_trie_data_t trie_data = current_trie->get_data();
-    return trie_data->get_table_index();
-  }
-  else
-    return -1;
-}
-*/
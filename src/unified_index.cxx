@@ -0,0 +1,177 @@
+#include "unified_index.hxx"
+#include "digit_cursor.hxx"
+#include "exceptions.hxx"
+
+using namespace trie;
+
+/**
+    Merges the frozen tries of all the rate tables of a partition into one prefix tree
+*/
+UnifiedIndex::UnifiedIndex(const p_frozen_tries_t frozen_tries) : frozen_tries(frozen_tries), jump_table(nullptr) {
+  cursors_t cursors;
+  for (size_t i = 0; i < frozen_tries->size(); ++i)
+    cursors.push_back({(uint32_t)i, 0});
+  merge_nodes(cursors, 0, cursors.size());
+  unified_node_t sentinel_node;     // Marks the end of the postings of the last node
+  sentinel_node.children_bitmap = 0;
+  sentinel_node.children_pos = child_offsets.size();
+  sentinel_node.postings_pos = postings.size();
+  nodes.push_back(sentinel_node);
+  nodes.shrink_to_fit();
+  child_offsets.shrink_to_fit();
+  postings.shrink_to_fit();
+}
+
+UnifiedIndex::~UnifiedIndex() {
+  delete jump_table;
+}
+
+/**
+    Adds a jump table over the given number of leading digits of the partition codes
+*/
+void UnifiedIndex::add_jump_table(unsigned char jump_digits) {
+  if (jump_table || jump_digits == 0 || jump_digits > JumpTable::MAX_JUMP_DIGITS)
+    return;
+  jump_table = new JumpTable(*this, jump_digits);
+}
+
+/**
+    Appends, in DFS (pre-order) layout, the node merging the given frozen trie nodes and
+    the nodes merging their descendants. Returns the offset of the merged node.
+*/
+uint32_t UnifiedIndex::merge_nodes(cursors_t &cursors, size_t cursors_begin, size_t cursors_end) {
+  uint32_t node_offset = nodes.size();
+  unified_node_t node;
+  node.children_bitmap = 0;
+  node.children_pos = child_offsets.size();
+  node.postings_pos = postings.size();
+  unsigned char children_count = 0;
+  for (size_t i = cursors_begin; i < cursors_end; ++i) {
+    cursor_t cursor = cursors[i];
+    p_frozen_trie_t frozen_trie = (*frozen_tries)[cursor.table_pos];
+    uint32_t record = frozen_trie->get_record(cursor.node_offset);
+    if (record != RateStore::NO_RECORD)
+      postings.push_back({cursor.table_pos, record});
+    for (unsigned char j = 0; j < 10; ++j)
+      if (frozen_trie->get_child(cursor.node_offset, j) != FrozenTrie::NO_NODE)
+        node.children_bitmap |= 1 << j;
+  }
+  for (unsigned char j = 0; j < 10; ++j)
+    if (node.children_bitmap & (1 << j))
+      children_count++;
+  nodes.push_back(node);
+  child_offsets.resize(child_offsets.size() + children_count);
+  uint32_t child_pos = node.children_pos;
+  for (unsigned char j = 0; j < 10; ++j) {
+    if ((node.children_bitmap & (1 << j)) == 0)
+      continue;
+    size_t child_cursors_begin = cursors.size();
+    for (size_t i = cursors_begin; i < cursors_end; ++i) {
+      cursor_t cursor = cursors[i];
+      uint32_t child_offset = (*frozen_tries)[cursor.table_pos]->get_child(cursor.node_offset, j);
+      if (child_offset != FrozenTrie::NO_NODE)
+        cursors.push_back({cursor.table_pos, child_offset});
+    }
+    uint32_t child_offset = merge_nodes(cursors, child_cursors_begin, cursors.size());
+    cursors.resize(child_cursors_begin);
+    child_offsets[child_pos++] = child_offset;
+  }
+  return node_offset;
+}
+
+uint32_t UnifiedIndex::get_child(uint32_t node_offset, unsigned char index) const {
+  if (index > 9)
+    throw TrieInvalidChildIndexException();
+  const unified_node_t &node = nodes[node_offset];
+  uint16_t mask = 1 << index;
+  if ((node.children_bitmap & mask) == 0)
+    return NO_NODE;
+  return child_offsets[node.children_pos + __builtin_popcount(node.children_bitmap & (mask - 1))];
+}
+
+bool UnifiedIndex::has_data(uint32_t node_offset) const {
+  return nodes[node_offset].postings_pos != nodes[node_offset + 1].postings_pos;
+}
+
+size_t UnifiedIndex::size() const {
+  return nodes.size() - 1;
+}
+
+/**
+    Bytes taken by the index nodes and postings (rate stores excluded)
+*/
+size_t UnifiedIndex::memory_usage() const {
+  size_t usage = sizeof(UnifiedIndex) + nodes.capacity() * sizeof(unified_node_t) +
+                 child_offsets.capacity() * sizeof(uint32_t) + postings.capacity() * sizeof(posting_t);
+  if (jump_table)
+    usage += jump_table->memory_usage();
+  return usage;
+}
+
+size_t UnifiedIndex::postings_size() const {
+  return postings.size();
+}
+
+/**
+    Merges the postings of the given node into the matches, kept sorted by table position
+*/
+void UnifiedIndex::visit_node(uint32_t node_offset, unsigned long long code, table_matches_t &matches, table_matches_t &merged_matches, rate_type_t rate_type, uint32_t filter_code_name_id) const {
+  uint32_t postings_begin = nodes[node_offset].postings_pos;
+  uint32_t postings_end = nodes[node_offset + 1].postings_pos;
+  if (postings_begin == postings_end)
+    return;
+  merged_matches.clear();
+  size_t match_pos = 0;
+  for (uint32_t i = postings_begin; i < postings_end; ++i) {
+    const posting_t &posting = postings[i];
+    while (match_pos < matches.size() && matches[match_pos].table_pos < posting.table_pos)
+      merged_matches.push_back(matches[match_pos++]);
+    if (match_pos < matches.size() && matches[match_pos].table_pos == posting.table_pos)
+      merged_matches.push_back(matches[match_pos++]);
+    else
+      merged_matches.push_back({posting.table_pos, PrefixMatch()});
+    p_rate_store_t rate_store = (*frozen_tries)[posting.table_pos]->get_rate_store();
+    merged_matches.back().match.visit(rate_store, posting.record, code, rate_type, filter_code_name_id);
+  }
+  while (match_pos < matches.size())
+    merged_matches.push_back(matches[match_pos++]);
+  matches.swap(merged_matches);
+}
+
+/**
+    Longest prefix search in every rate table of the partition with a single descent.
+    Same semantics as running FrozenTrie::search_code in each of them.
+*/
+void UnifiedIndex::search_code(unsigned long long code, rate_type_t rate_type, time_t reference_time, search::SearchResult &search_result, uint32_t filter_code_name_id, bool include_code) const {
+  table_matches_t matches;
+  table_matches_t merged_matches;
+  uint32_t current_node = 0;
+  unsigned long long current_code = 0;
+  auto descend = [&](unsigned char child_index) {
+    current_node = get_child(current_node, child_index);
+    if (current_node == NO_NODE)
+      return;
+    current_code = current_code * 10 + child_index;
+    visit_node(current_node, current_code, matches, merged_matches, rate_type, filter_code_name_id);
+  };
+  DigitCursor digit_cursor(code);
+  if (jump_table) {
+    uint32_t slot;
+    unsigned char leading_count = jump_table->read_slot(digit_cursor, slot);
+    if (leading_count == jump_table->get_jump_digits()) {
+      for (const jump_mark_t *mark = jump_table->marks_begin(slot); mark != jump_table->marks_end(slot); ++mark)
+        visit_node(mark->node, jump_table->get_mark_code(slot, *mark), matches, merged_matches, rate_type, filter_code_name_id);
+      current_node = jump_table->get_node(slot);
+      current_code = slot;
+    }
+    else
+      for (unsigned char i = 0; i < leading_count && current_node != NO_NODE; ++i)
+        descend(JumpTable::get_digit(slot, leading_count, i));
+  }
+  while (current_node != NO_NODE && digit_cursor.has_more_digits())
+    descend(digit_cursor.next_digit());
+  for (auto it = matches.begin(); it != matches.end(); ++it) {
+    unsigned int rate_table_id = (*frozen_tries)[it->table_pos]->get_rate_table_id();
+    it->match.insert_into(search_result, rate_table_id, rate_type, reference_time, include_code);
+  }
+}
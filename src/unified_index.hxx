@@ -0,0 +1,71 @@
+/**
+      Prefix tree shared by all the rate tables of a partition, so one descent serves every table
+*/
+#ifndef UNIFIED_INDEX_HXX
+#define UNIFIED_INDEX_HXX
+
+#include "frozen_trie.hxx"
+#include "jump_table.hxx"
+#include "search_result.hxx"
+#include "shared.hxx"
+#include <vector>
+#include <cstdint>
+#include <time.h>
+
+namespace trie {
+
+  class UnifiedIndex;
+  typedef UnifiedIndex* p_unified_index_t;
+
+  /** Rate record of one rate table, posted at the node of its code */
+  typedef struct {
+    uint32_t table_pos;
+    uint32_t record;
+  } posting_t;
+
+  /**
+      Node of the unified index. Postings of a node are sorted by table position and
+      end where the postings of the next node (in DFS order) start.
+  */
+  typedef struct {
+    uint16_t children_bitmap;
+    uint32_t children_pos;
+    uint32_t postings_pos;
+  } unified_node_t;
+
+  class UnifiedIndex {
+    private:
+      typedef std::vector<unified_node_t> unified_nodes_t;
+      typedef std::vector<uint32_t> child_offsets_t;
+      typedef std::vector<posting_t> postings_t;
+      typedef struct {
+        uint32_t table_pos;
+        uint32_t node_offset;
+      } cursor_t;
+      typedef std::vector<cursor_t> cursors_t;
+      typedef struct {
+        uint32_t table_pos;
+        PrefixMatch match;
+      } table_match_t;
+      typedef std::vector<table_match_t> table_matches_t;
+      p_frozen_tries_t frozen_tries;
+      unified_nodes_t nodes;
+      child_offsets_t child_offsets;
+      postings_t postings;
+      p_jump_table_t jump_table;
+      uint32_t merge_nodes(cursors_t &cursors, size_t cursors_begin, size_t cursors_end);
+      void visit_node(uint32_t node_offset, unsigned long long code, table_matches_t &matches, table_matches_t &merged_matches, rate_type_t rate_type, uint32_t filter_code_name_id) const;
+    public:
+      static const uint32_t NO_NODE = UINT32_MAX;
+      UnifiedIndex(const p_frozen_tries_t frozen_tries);
+      ~UnifiedIndex();
+      void add_jump_table(unsigned char jump_digits);
+      uint32_t get_child(uint32_t node_offset, unsigned char index) const;
+      bool has_data(uint32_t node_offset) const;
+      size_t size() const;
+      size_t memory_usage() const;
+      size_t postings_size() const;
+      void search_code(unsigned long long code, rate_type_t rate_type, time_t reference_time, search::SearchResult &search_result, uint32_t filter_code_name_id = ctrl::NO_CODE_NAME_ID, bool include_code = false) const;
+  };
+}
+#endif